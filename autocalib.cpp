@@ -0,0 +1,153 @@
+#include <Arduino.h>
+#include "autocalib.h"
+
+//------------------------------------------ class REF_METER: the reference thermometer on the serial port ----
+void REF_METER::poll(void) {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\r') continue;
+        if (c == '\n') {
+            if (!overflow && parse()) {
+                valid   = true;
+                read_ms = millis();
+                ++count;
+            }
+            len      = 0;
+            overflow = false;
+        } else if (len < sizeof(line)) {
+            line[len++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+}
+
+bool REF_METER::fresh(void) {
+    return valid && (millis() - read_ms < fresh_ms);
+}
+
+// <Celsius>[.<tenths>], the spaces around are skipped, the digits after the tenths are dropped
+bool REF_METER::parse(void) {
+    uint8_t i = 0;
+    while (i < len && line[i] == ' ') ++i;
+    int16_t v = 0;
+    uint8_t digits = 0;
+    for (; i < len && isdigit(line[i]); ++i) {
+        if (++digits > 3) return false;                                     // Up to 999 Celsius
+        v = v * 10 + (line[i] - '0');
+    }
+    if (digits == 0) return false;
+    v *= 10;
+    if (i < len && line[i] == '.') {
+        ++i;
+        if (i < len && isdigit(line[i]))
+            v += line[i++] - '0';
+        while (i < len && isdigit(line[i])) ++i;
+    }
+    while (i < len && line[i] == ' ') ++i;
+    if (i != len) return false;
+    value = v;
+    return true;
+}
+
+//------------------------------------------ class AUTO_CALIB: the calibration by the reference thermometer ----
+void AUTO_CALIB::start(void) {
+    ref.init();
+    last_reading = 0;
+    index       = 0;
+    attempts    = 0;
+    shift       = 0;
+    pCfg->getCalibrationData(calib);
+    pHG->setFan(tune_fan_speed);                                            // See vars.cpp
+    heat(pCfg->tempInternal(calib_tip[0]));
+    point_ms    = millis();
+    pHG->switchPower(true);
+}
+
+void AUTO_CALIB::stop(void) {
+    if (state == AC_HEAT || state == AC_MEASURE)
+        state = AC_IDLE;
+    pHG->switchPower(false);
+}
+
+void AUTO_CALIB::result(uint16_t tip[]) {
+    for (uint8_t i = 0; i < calib_points; ++i)
+        tip[i] = calib[i];
+}
+
+void AUTO_CALIB::heat(uint16_t temp) {
+    temp_set    = constrain(temp, 0, temp_max);
+    pHG->setTemp(temp_set);
+    settle_ms   = millis() + settle_time;
+    measured    = 0;
+    meter_summ  = 0;
+    temp_summ   = 0;
+    state       = AC_HEAT;
+}
+
+AUTO_CALIB::Status AUTO_CALIB::update(void) {
+    ref.poll();                                                             // Keep the serial buffer empty
+    if (state != AC_HEAT && state != AC_MEASURE) return state;
+    uint16_t t  = pHG->averageTemp();
+    uint32_t ms = millis();
+
+    if (t >= temp_max || ms - point_ms > point_timeout) {                   // Over heating or no convergence
+        state = AC_FAILED;
+        pHG->switchPower(false);
+        return state;
+    }
+    bool stable = (abs(int16_t(temp_set) - int16_t(t)) <= temp_tol) && (pHG->pwrDispersion() <= pwr_disp_max)
+        && (pHG->avgPowerPcnt() > 1) && (ms >= settle_ms) && ref.fresh();
+    if (!stable) {
+        if (state == AC_MEASURE) {                                          // Start the averaging again
+            measured    = 0;
+            meter_summ  = 0;
+            temp_summ   = 0;
+            state       = AC_HEAT;
+        }
+        return state;
+    }
+    if (ref.readings() == last_reading) return state;                       // Wait for the next meter reading
+    last_reading = ref.readings();
+    state        = AC_MEASURE;
+    meter_summ  += ref.temp10();
+    temp_summ   += t;
+    if (++measured < measure_readings) return state;
+
+    int16_t err10   = int16_t(calib_tip[index]) * 10 - int16_t((meter_summ + (measure_readings >> 1)) / measure_readings);
+    int32_t reading = (temp_summ + (measure_readings >> 1)) / measure_readings + correction(err10);
+    reading = constrain(reading, 0, temp_max);
+    if (abs(err10) > servo_tol) {                                           // Move the preset temperature to the reference point
+        if (++attempts >= max_attempts) {
+            state = AC_FAILED;
+            pHG->switchPower(false);
+        } else {
+            heat(reading);
+        }
+        return state;
+    }
+    calib[index] = reading;
+    shift = reading - int16_t(pCfg->tempInternal(calib_tip[index]));
+    if (++index >= calib_points) {
+        state = AC_DONE;
+        for (uint8_t i = 1; i < calib_points; ++i)
+            if (calib[i] <= calib[i-1]) state = AC_FAILED;
+        pHG->switchPower(false);
+        return state;
+    }
+    attempts = 0;
+    point_ms = ms;
+    heat(int16_t(pCfg->tempInternal(calib_tip[index])) + shift);
+    return state;
+}
+
+// The slope of the current calibration around the reference point, rounded
+int32_t AUTO_CALIB::correction(int16_t err10) {
+    uint16_t c  = calib_tip[index];
+    uint16_t lo = (c > temp_minC + 10)?c - 10:temp_minC;
+    uint16_t hi = (c + 10 < temp_maxC)?c + 10:temp_maxC;
+    int32_t  d  = int32_t(pCfg->tempInternal(hi)) - int32_t(pCfg->tempInternal(lo));
+    int32_t  n  = int32_t(hi - lo) * 10;
+    int32_t  e  = int32_t(err10) * d;
+    return (e >= 0)?(e + n/2) / n:(e - n/2) / n;
+}
@@ -0,0 +1,81 @@
+#ifndef _AUTOCALIB_H_
+#define _AUTOCALIB_H_
+
+#include <stdint.h>
+#include "gun.h"
+#include "config.h"
+#include "vars.h"
+
+//------------------------------------------ class REF_METER: the reference thermometer on the serial port ----
+/* The reference thermocouple reader sends the air temperature as the text lines (115200 bauds, see setup()):
+ *   <Celsius>[.<tenths>]\n                   for example "245.3", '\r' is ignored
+ * The other lines are ignored, so the meter with the prefix or the units can be adapted by the line parser.
+ * The reading is fresh for 'fresh_ms' after the line is received.
+ */
+class REF_METER {
+    public:
+        void        init(void)                                              { len = 0; valid = false; count = 0; }
+        void        poll(void);                                             // Read the serial port, call it often
+        bool        fresh(void);                                            // Whether the last reading is recent
+        int16_t     temp10(void)                                            { return value;     }   // The last reading, tenths of Celsius
+        uint16_t    readings(void)                                          { return count;     }   // The number of the readings received
+    private:
+        bool        parse(void);
+        char        line[16];                                               // The line being received
+        uint8_t     len             = 0;
+        bool        overflow        = false;                                // The line is too long, skip it
+        bool        valid           = false;
+        int16_t     value           = 0;
+        uint16_t    count           = 0;
+        uint32_t    read_ms         = 0;                                    // The time the last reading received
+        const uint16_t  fresh_ms    = 2000;
+};
+
+//------------------------------------------ class AUTO_CALIB: the calibration by the reference thermometer ----
+/* The Hot Air Gun is heated to every reference point (calib_tip) one by one. When the temperature is stable
+ * (see calibSCREEN) the readings of the reference meter and the sensor are averaged for 'measure_readings'
+ * meter readings. The sensor reading at the reference point is the average one corrected by the error of the
+ * meter reading and the local slope of the current calibration (internal units per Celsius). If the error
+ * is bigger than 'servo_tol', the preset temperature is moved to the corrected reading and the point is measured
+ * again, so the correction by the slope is small. The correction of the point is applied to the first guess of
+ * the next one. The result is ascending sensor readings, the screen applies and saves them.
+ */
+class AUTO_CALIB {
+    public:
+        typedef enum { AC_IDLE, AC_HEAT, AC_MEASURE, AC_DONE, AC_FAILED } Status;
+        AUTO_CALIB(HOTGUN* HG, HOTGUN_CFG* Cfg)                             { pHG = HG; pCfg = Cfg; }
+        void        start(void);                                            // Start at the first reference point
+        Status      update(void);                                           // Call it often, at least once per power period
+        void        stop(void);                                             // Abort the calibration, switch off the power
+        Status      status(void)                                            { return state;             }
+        uint8_t     point(void)                                             { return index;             }   // The current reference point
+        REF_METER&  meter(void)                                             { return ref;               }
+        void        result(uint16_t tip[]);                                 // The sensor readings at the reference points
+    private:
+        void        heat(uint16_t temp);                                    // Preset the temperature (internal units) and wait for it
+        int32_t     correction(int16_t err10);                              // The internal units of the error (tenths of Celsius)
+        HOTGUN*     pHG;
+        HOTGUN_CFG* pCfg;
+        REF_METER   ref;
+        Status      state           = AC_IDLE;
+        uint8_t     index           = 0;                                    // The reference point being measured
+        uint8_t     attempts        = 0;                                    // The measurements of the current point
+        uint16_t    temp_set        = 0;                                    // The preset temperature (internal units)
+        int16_t     shift           = 0;                                    // The correction of the previous point (internal units)
+        uint16_t    last_reading    = 0;                                    // The meter readings counter of the last averaged reading
+        uint8_t     measured        = 0;                                    // The readings averaged
+        int32_t     meter_summ      = 0;                                    // The summ of the meter readings, tenths of Celsius
+        uint32_t    temp_summ       = 0;                                    // The summ of the sensor readings (internal units)
+        uint32_t    settle_ms       = 0;                                    // The time the temperature can be checked
+        uint32_t    point_ms        = 0;                                    // The time the point measurement started
+        uint16_t    calib[max_calib_points];                                // The sensor readings at the reference points
+        const uint8_t   measure_readings = 10;                              // The meter readings to be averaged
+        const uint8_t   servo_tol       = 20;                               // The maximum error to accept the point, tenths of Celsius
+        const uint8_t   max_attempts    = 6;                                // The measurements of the point before the failure
+        const uint8_t   temp_tol        = 16;                               // The temperature is stable: the error (internal units)
+        const uint16_t  pwr_disp_max    = 100;                              // and the power dispersion, see calibSCREEN
+        const uint32_t  settle_time     = 20000;                            // The time to settle after the preset temperature changed, ms
+        const uint32_t  point_timeout   = 600000;                           // The time to calibrate one point, ms
+};
+
+#endif
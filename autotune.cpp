@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include "autotune.h"
+
+//------------------------------------------ class RELAY_TUNE: PID auto-tune by the relay feedback ------------
+void RELAY_TUNE::start(uint16_t temp, uint8_t max_power) {
+    temp_set    = temp;
+    p_max       = max_power;
+    p_high      = max_power;
+    p_low       = 1;                                                        // Zero power switches the Hot Air Gun off
+    cycles      = 0;
+    amp_summ    = 0;
+    period_summ = 0;
+    hp_summ     = 0;
+    swing       = 0;
+    start_ms    = millis();
+    state       = RT_HEAT;
+    relay(true);
+}
+
+void RELAY_TUNE::stop(void) {
+    if (state == RT_HEAT || state == RT_RELAY)
+        state = RT_IDLE;
+    pHG->fixPower(0);
+}
+
+RELAY_TUNE::Status RELAY_TUNE::update(void) {
+    if (state != RT_HEAT && state != RT_RELAY) return state;
+    uint16_t t  = pHG->averageTemp();
+    uint32_t ms = millis();
+
+    if (t >= temp_max) {                                                    // Prevent global over heating (see vars.cpp)
+        state = RT_FAILED;
+    } else if (state == RT_HEAT) {
+        if (t > temp_set + hysteresis) {                                    // The preset temperature reached, start oscillation
+            relay(false);
+            start_ms    = ms;
+            start_hp    = pHG->halfPeriods();
+            high_summ   = 0;
+            t_max = t_min = t;
+            state       = RT_RELAY;
+        } else if (ms - start_ms > heat_timeout) {
+            state = RT_FAILED;
+        }
+    } else {
+        if (t > t_max) t_max = t;
+        if (t < t_min) t_min = t;
+        if (relay_high) {
+            if (t > temp_set + hysteresis) {                                // The cycle is complete
+                uint32_t cycle_ms = ms - start_ms;
+                uint16_t hp       = pHG->halfPeriods();
+                relay(false);
+                high_summ += ms - high_ms;
+                if (cycles < settle_cycles) {
+                    center(cycle_ms);
+                } else {
+                    amp_summ    += (t_max - t_min) >> 1;
+                    period_summ += cycle_ms;
+                    hp_summ     += uint16_t(hp - start_hp);             // The cycle is shorter than the counter wrap
+                    swing        = (p_high - p_low) >> 1;
+                }
+                ++cycles;
+                start_ms    = ms;
+                start_hp    = hp;
+                high_summ   = 0;
+                t_max = t_min = t;
+                if (cycles >= settle_cycles + measure_cycles)
+                    state = RT_DONE;
+            }
+        } else if (t < temp_set - hysteresis) {
+            relay(true);
+        }
+        if (state == RT_RELAY && ms - start_ms > cycle_timeout)             // No oscillation
+            state = RT_FAILED;
+    }
+    if (state == RT_FAILED || state == RT_DONE)
+        pHG->fixPower(0);
+    return state;
+}
+
+/*
+ * Ku = 4*d / (pi * sqrt(a^2 - e^2)), the Ziegler-Nichols rule detuned:
+ * Kc = Ku/10, Ti = Tu, Td = Tu/4 (the best rule on the plant model, see host/tools/hg_tune_pid -a).
+ * The iterative formula (see PID class) is calculated every power period T:
+ *   Kp = Kc, Ki = Kc * T / Ti, Kd = Kc * Td / T, multiplied by the denominator
+ * T is 100 AC half-periods, 833 ms of 60 Hz mains, so Tu is counted in half-periods by HOTGUN_HW, not by millis().
+ */
+bool RELAY_TUNE::gains(int16_t k[3]) {
+    if (state != RT_DONE) return false;
+    float a  = float(amplitude());
+    float a2 = a * a - float(hysteresis) * float(hysteresis);
+    if (a2 <= 0 || swing == 0) return false;
+    float ku = 4.0 * swing / (PI * sqrt(a2));
+    float tu = float(hp_summ) / (uint16_t(pid_period) * measure_cycles);    // The period in the PID iterations
+    float kc = ku / 10.0 * (1 << 13);
+    float g[3] = { kc, kc / tu, kc * tu / 4.0f };
+    for (uint8_t i = 0; i < 3; ++i) {
+        if (g[i] > PID_Q13::gain_max) g[i] = PID_Q13::gain_max;
+        k[i] = int16_t(g[i] + 0.5);
+    }
+    if (k[0] < 1 || k[1] < 1) return false;
+    return true;
+}
+
+void RELAY_TUNE::relay(bool high) {
+    relay_high = high;
+    if (high) high_ms = millis();
+    pHG->fixPower(high?p_high:p_low);
+}
+
+// Move the power levels to keep the average power of the cycle in the middle
+void RELAY_TUNE::center(uint32_t cycle_ms) {
+    if (cycle_ms == 0) return;
+    int16_t avg = p_low + uint32_t(p_high - p_low) * high_summ / cycle_ms;
+    int16_t d   = avg - 1;
+    if (p_max - avg < d) d = p_max - avg;
+    if (d < min_swing) d = min_swing;                                       // Near the power limit the swing is not symmetric
+    p_high  = constrain(avg + d, min_swing, p_max);
+    p_low   = constrain(avg - d, 1, p_max - min_swing);
+}
@@ -0,0 +1,61 @@
+#ifndef _AUTOTUNE_H_
+#define _AUTOTUNE_H_
+
+#include <stdint.h>
+#include "gun.h"
+
+//------------------------------------------ class RELAY_TUNE: PID auto-tune by the relay feedback ------------
+/* Astrom-Hagglund relay experiment. The Hot Air Gun is heated by the fixed power (see HOTGUN::fixPower()),
+ * that is switched between the high and the low level when the temperature crosses the preset one
+ * (with the small hysteresis e), so the temperature oscillates around the preset one.
+ * After every cycle the power levels are moved to keep the average power in the middle of them,
+ * it makes the oscillation symmetric. The last cycles are measured: the amplitude of the temperature a
+ * and the period Tu give the ultimate gain Ku = 4*d / (pi * sqrt(a^2 - e^2)), where d is the half of the
+ * power swing. The PID coefficients are calculated by the Ziegler-Nichols rule for the iterative formula
+ * of the PID class (see gun.h), the coefficients are multiplied by the denominator.
+ */
+class RELAY_TUNE {
+    public:
+        typedef enum { RT_IDLE, RT_HEAT, RT_RELAY, RT_DONE, RT_FAILED } Status;
+        RELAY_TUNE(HOTGUN* HG)                                              { pHG = HG; }
+        void        start(uint16_t temp_set, uint8_t max_power);            // Start the experiment at the preset temperature (internal units)
+        Status      update(void);                                           // Call it often, at least once per power period
+        void        stop(void);                                             // Abort the experiment, switch off the power
+        Status      status(void)                                            { return state;                 }
+        uint8_t     cycle(void)                                             { return cycles;                }
+        uint8_t     totalCycles(void)                                       { return settle_cycles + measure_cycles; }
+        uint8_t     power(void)                                             { return relay_high?p_high:p_low; }
+        uint16_t    amplitude(void)                                         { return amp_summ / measure_cycles; }
+        uint32_t    periodMs(void)                                          { return period_summ / measure_cycles; }
+        bool        gains(int16_t k[3]);                                    // Kp, Ki, Kd calculated by the experiment
+    private:
+        void        relay(bool high);
+        void        center(uint32_t cycle_ms);
+        HOTGUN*     pHG;                                                    // Pointer to the HOTGUN instance
+        Status      state           = RT_IDLE;
+        uint16_t    temp_set        = 0;                                    // The preset temperature (internal units)
+        uint8_t     p_max           = 0;                                    // The maximum power to be applied
+        uint8_t     p_high          = 0;                                    // The high power level of the relay
+        uint8_t     p_low           = 0;                                    // The low power level of the relay
+        bool        relay_high      = false;                                // The relay status
+        uint8_t     cycles          = 0;                                    // The number of complete oscillation cycles
+        uint16_t    t_max           = 0;                                    // The maximum temperature of the current cycle
+        uint16_t    t_min           = 0;                                    // The minimum temperature of the current cycle
+        uint32_t    start_ms        = 0;                                    // The time the experiment (or the cycle) started
+        uint16_t    start_hp        = 0;                                    // The AC half-periods counter the cycle started at
+        uint32_t    high_ms         = 0;                                    // The time the relay switched to the high level
+        uint32_t    high_summ       = 0;                                    // The time the relay was high in the current cycle, ms
+        uint32_t    amp_summ        = 0;                                    // Sum of the measured amplitudes (internal units)
+        uint32_t    period_summ     = 0;                                    // Sum of the measured periods, ms
+        uint32_t    hp_summ         = 0;                                    // Sum of the measured periods, AC half-periods
+        uint8_t     swing           = 0;                                    // The half of the power swing of the measured cycles
+        const uint8_t   hysteresis      = 12;                               // The relay hysteresis (internal units)
+        const uint8_t   min_swing       = 15;                               // The minimum half power swing
+        const uint8_t   settle_cycles   = 3;                                // The cycles to center the power levels
+        const uint8_t   measure_cycles  = 4;                                // The cycles to be measured
+        const uint32_t  heat_timeout    = 300000;                           // The time to reach the preset temperature, ms
+        const uint32_t  cycle_timeout   = 180000;                           // The maximum oscillation period, ms
+        const uint8_t   pid_period      = 100;                              // The PID coefficients are per power period of 100 half-periods, 50 or 60 Hz
+};
+
+#endif
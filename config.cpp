@@ -4,12 +4,14 @@
 //------------------------------------------ Configuration data ------------------------------------------------
 /* Config record in the EEPROM has the following format:
  * uint32_t ID                           each time increment by 1
- * struct cfg                            config data, 9 bytes
- * byte CRC                              the checksum
+ * byte version                          the record layout version, cfg_version
+ * struct cfg                            config data, 26 bytes
+ * byte CRC                              CRC8 of the record
+ * The fixed record at the end of the EEPROM: byte version, data, byte CRC (see config.h)
 */
 // Read the records until the last one, point wAddr (write address) after the last record
 void CONFIG::init(void) {
-    eLength = EEPROM.length();
+    eLength = EEPROM.length() - fixed_size;
     uint32_t recID;
     uint32_t minRecID = 0xffffffff;
     uint16_t minRecAddr = 0;
@@ -45,7 +47,7 @@ void CONFIG::init(void) {
     rAddr = maxRecAddr;
     if (records < (eLength / record_size)) {                                // The EEPROM is not full
         wAddr = rAddr + record_size;
-        if (wAddr > eLength) wAddr = 0;
+        if (wAddr + record_size > eLength) wAddr = 0;
     } else {
         wAddr = minRecAddr;
     }
@@ -71,23 +73,25 @@ bool CONFIG::save(void) {
 
     uint16_t startWrite = wAddr;
     uint32_t nxt = nextRecID;
-    uint8_t summ = 0;
+    uint8_t crc = 0;
     for (uint8_t i = 0; i < 4; ++i) {
         EEPROM.write(startWrite++, nxt & 0xff);
-        summ <<=2; summ += nxt;
+        crc = crc8(crc, nxt & 0xff);
         nxt >>= 8;
     }
+    EEPROM.write(startWrite++, cfg_version);
+    crc = crc8(crc, cfg_version);
     uint8_t* p = (uint8_t *)&Config;
-    for (uint8_t i = 0; i < sizeof(struct cfg); ++i) {
-        summ <<= 2; summ += p[i];
-        EEPROM.write(startWrite++, p[i]);
+    for (uint8_t i = 0; i < record_size - 6; ++i) {
+        uint8_t b = (i < sizeof(struct cfg))?p[i]:0;                        // Zero padding up to the record size
+        EEPROM.write(startWrite++, b);
+        crc = crc8(crc, b);
     }
-    summ ++;                                                                // To avoid empty records
-    EEPROM.write(wAddr+record_size-1, summ);
+    EEPROM.write(startWrite, crc);
 
     rAddr = wAddr;
     wAddr += record_size;
-    if (wAddr > EEPROM.length()) wAddr = 0;
+    if (wAddr + record_size > eLength) wAddr = 0;
     nextRecID ++;                                                           // Get ready to write next record
     return true;
 }
@@ -104,38 +108,72 @@ bool CONFIG::readRecord(uint16_t addr, uint32_t &recID) {
     for (uint8_t i = 0; i < record_size; ++i) 
         Buff[i] = EEPROM.read(addr+i);
   
-    uint8_t summ = 0;
-    for (uint8_t i = 0; i < sizeof(struct cfg) + 4; ++i) {
-        summ <<= 2; summ += Buff[i];
-    }
-    summ ++;                                                                // To avoid empty fields
-    if (summ == Buff[record_size-1]) {                                      // Checksumm is correct
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < record_size - 1; ++i)
+        crc = crc8(crc, Buff[i]);
+    // The empty (0xff) or zeroed EEPROM and the records of the other layout have the wrong version
+    if (crc == Buff[record_size-1] && Buff[4] == cfg_version) {
         uint32_t ts = 0;
         for (char i = 3; i >= 0; --i) {
             ts <<= 8;
             ts |= Buff[uint8_t(i)];
         }
         recID = ts;
-        memcpy(&Config, &Buff[4], sizeof(struct cfg));
+        memcpy(&Config, &Buff[5], sizeof(struct cfg));
         return true;
     }
     return false;
 }
 
+bool CONFIG::loadFixed(uint8_t *data, uint8_t size) {
+    uint16_t addr = EEPROM.length() - fixed_size;
+    if (size > fixed_size - 2 || EEPROM.read(addr) != cfg_version) return false;
+    uint8_t crc = crc8(0, cfg_version);
+    for (uint8_t i = 0; i < size; ++i) {
+        data[i] = EEPROM.read(++addr);
+        crc = crc8(crc, data[i]);
+    }
+    return crc == EEPROM.read(++addr);
+}
+
+void CONFIG::saveFixed(const uint8_t *data, uint8_t size) {
+    if (size > fixed_size - 2) return;
+    uint16_t addr = EEPROM.length() - fixed_size;
+    EEPROM.update(addr, cfg_version);
+    uint8_t crc = crc8(0, cfg_version);
+    for (uint8_t i = 0; i < size; ++i) {
+        EEPROM.update(++addr, data[i]);
+        crc = crc8(crc, data[i]);
+    }
+    EEPROM.update(++addr, crc);
+}
+
+// x^8 + x^5 + x^4 + 1, bit by bit: the config is read once and written rarely, the table is not worth the flash
+uint8_t CONFIG::crc8(uint8_t crc, uint8_t data) {
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; ++i)
+        crc = (crc & 1)?(crc >> 1) ^ 0x8C:crc >> 1;
+    return crc;
+}
+
 //------------------------------------------ class HOT GUN CONFIG ----------------------------------------------
+static_assert(sizeof(PID_TABLE) + 2 <= CONFIG::fixed_size, "The PID gain schedule does not fit the fixed record");
+
 void HOTGUN_CFG::init(void) {
     CONFIG::init();
     if (!CONFIG::load()) setDefaults(false);                                // If failed to load the data from EEPROM, initialize the config data with the default values
-    uint32_t   cd = Config.calibration;
-    t_tip[0] = cd & 0x3FF; cd >>= 10;                                       // 10 bits per calibration parameter, because the ADC readings are 10 bits
-    t_tip[1] = cd & 0x3FF; cd >>= 10;
-    t_tip[2] = cd & 0x3FF;
+    for (uint8_t i = 0; i < calib_points; ++i)
+        t_tip[i] = unpackCalib(Config.calibration, i);                      // 12 bits per calibration parameter, see HOTGUN_HW
     // Check the tip calibration is correct
-    if ((t_tip[0] >= t_tip[1]) || (t_tip[1] >= t_tip[2])) {
+    if (!validCalibration()) {
         setDefaults(false);
-        for (uint8_t i = 0; i < 3; ++i)
-            t_tip[i] = def_tip[i];
+        for (uint8_t i = 0; i < calib_points; ++i)
+            t_tip[i] = unpackCalib(Config.calibration, i);
     }
+    if (!CONFIG::loadFixed((uint8_t *)pid, sizeof(PID_TABLE)))
+        memset(pid, 0, sizeof(PID_TABLE));                                  // The factory PID gain schedule
+    validTables();
+    buildTables();
     return;
 }
 
@@ -147,56 +185,104 @@ uint16_t HOTGUN_CFG::fanPreset(void) {
     return Config.fan;
 }
 
+// The lowest internal temperature x of the segment with floor((x - in_min) * slope) >= t - out_min:
+// ceil((t - out_min) * r_slope), the reciprocal slope is exact while (t - out_min) * Celsius span < 2^17
 uint16_t HOTGUN_CFG::tempInternal(uint16_t t) {                             // Translate the human readable temperature into internal value
     t = constrain(t, temp_minC, temp_maxC);
-    uint16_t left   = 0;
-    uint16_t right  = 1023;                                                 // Maximum temperature value in internal units
-    uint16_t temp = map(t, temp_tip[0], temp_tip[2], t_tip[0], t_tip[2]);
+    uint8_t s = 0;
+    while (s < calib_points-1 && t > calib_tip[s])
+        ++s;
+    uint16_t temp = seg[s].in_min + mulShift(t - seg[s].out_min, seg[s].r_slope, (1UL << 17) - 1, 17);
+    if (temp > 4095) temp = 4095;                                           // Maximum temperature value in internal units
+    return temp;
+}
 
-    if (temp > (left+right)/ 2) {
-        temp -= (right-left) / 4;
-    } else {
-        temp += (right-left) / 4;
+// Thanslate temperature from internal units to the human readable value (Celsius or Fahrenheit)
+uint16_t HOTGUN_CFG::tempHuman(uint16_t temp) {
+    if (temp <= ambient_temp)
+        return ambient_tempC;
+    if (temp > 4095) temp = 4095;                                           // 12-bit internal units, see HOTGUN_HW
+    uint8_t s = 0;
+    if (temp >= t_tip[0]) {
+        for (s = 1; s < calib_points-1 && temp > t_tip[s]; ++s) ;
     }
+    return seg[s].out_min + mulShift(temp - seg[s].in_min, seg[s].slope, 0, 24);
+}
 
-    for (uint8_t i = 0; i < 20; ++i) {
-        uint16_t tempH = tempHuman(temp);
-        if (tempH == t) {
-            return temp;
-        }
-        uint16_t new_temp;
-        if (tempH < t) {
-            left = temp;
-             new_temp = (left+right)/2;
-            if (new_temp == temp)
-                new_temp = temp + 1;
-        } else {
-            right = temp;
-            new_temp = (left+right)/2;
-            if (new_temp == temp)
-                new_temp = temp - 1;
+// The segments of the calibration, the last one is extended above the last reference point
+void HOTGUN_CFG::buildTables(void) {
+    buildSegment(0, ambient_temp, t_tip[0], ambient_tempC, calib_tip[0]);
+    for (uint8_t s = 1; s < calib_points; ++s)
+        buildSegment(s, t_tip[s-1], t_tip[s], calib_tip[s-1], calib_tip[s]);
+    for (uint8_t i = 0; i < 3; ++i)
+        t_sched[i] = tempInternal(temp_tip[i]);
+}
+
+// The readings should be above the ambient temperature and ascend, see HOTGUN_CFG::buildSegment()
+bool HOTGUN_CFG::validCalibration(void) {
+    if (t_tip[0] <= ambient_temp) return false;
+    for (uint8_t i = 1; i < calib_points; ++i)
+        if (t_tip[i] <= t_tip[i-1] || t_tip[i] > 4095) return false;
+    return true;
+}
+
+// The CRC passed, but the values are out of range anyway: the record of the broken firmware
+void HOTGUN_CFG::validTables(void) {
+    for (uint8_t t = 0; t < 3; ++t) {
+        for (uint8_t f = 0; f < 3; ++f) {
+            if (Config.power[t][f] > max_power) Config.power[t][f] = 0;
+            for (uint8_t k = 0; k < 3; ++k)
+                if (pid[t][f][k] < 0) pid[t][f][k] = 0;
         }
-        temp = new_temp;
     }
-    return temp;
 }
 
-// Thanslate temperature from internal units to the human readable value (Celsius or Fahrenheit)
-uint16_t HOTGUN_CFG::tempHuman(uint16_t temp) {
-    uint16_t tempH = 0;
-    
-    if (temp <= ambient_temp) {
-        tempH = ambient_tempC;
-    } else if (temp < t_tip[0]) {
-        tempH = map(temp, ambient_temp, t_tip[0], ambient_tempC, temp_tip[0]);
-    } else if (temp <= t_tip[1]) {
-        tempH = map(temp, t_tip[0], t_tip[1], temp_tip[0], temp_tip[1]);
-    } else if (temp <= t_tip[2]) {
-        tempH = map(temp, t_tip[1], t_tip[2], temp_tip[1], temp_tip[2]);
+// Two 12-bit values per three bytes: the low byte of the even value, both high nibbles, the high byte of the odd value
+uint16_t HOTGUN_CFG::unpackCalib(const uint8_t c[], uint8_t i) {
+    const uint8_t *p = &c[(i >> 1) * 3];
+    if (i & 1)
+        return (uint16_t(p[2]) << 4) | (p[1] >> 4);
+    return (uint16_t(p[1] & 0x0F) << 8) | p[0];
+}
+
+void HOTGUN_CFG::packCalib(uint8_t c[], uint8_t i, uint16_t value) {
+    uint8_t *p = &c[(i >> 1) * 3];
+    value &= 0xFFF;
+    if (i & 1) {
+        p[1] = (p[1] & 0x0F) | ((value & 0x0F) << 4);
+        p[2] = value >> 4;
     } else {
-        tempH = map(temp, t_tip[0], t_tip[2], temp_tip[0], temp_tip[2]);
+        p[0] = value & 0xFF;
+        p[1] = (p[1] & 0xF0) | (value >> 8);
     }
-    return tempH;
+}
+
+// The former three point calibration: the ambient temperature, def_tip at 200, 300 and 400 Celsius, extended by 200 - 400 line
+uint16_t HOTGUN_CFG::defaultReading(uint16_t tempC) {
+    if (tempC <= temp_tip[0])
+        return map(tempC, ambient_tempC, temp_tip[0], ambient_temp, def_tip[0]);
+    if (tempC <= temp_tip[1])
+        return map(tempC, temp_tip[0], temp_tip[1], def_tip[0], def_tip[1]);
+    if (tempC <= temp_tip[2])
+        return map(tempC, temp_tip[1], temp_tip[2], def_tip[1], def_tip[2]);
+    return map(tempC, temp_tip[0], temp_tip[2], def_tip[0], def_tip[2]);
+}
+
+void HOTGUN_CFG::buildSegment(uint8_t s, uint16_t in_min, uint16_t in_max, uint16_t out_min, uint16_t out_max) {
+    uint32_t d_in   = (in_max > in_min)?in_max - in_min:0;
+    uint32_t d_out  = (out_max > out_min)?out_max - out_min:0;              // Less than 256 Celsius, see calib_tip
+    if (d_out > 255) d_out = 255;
+    seg[s].in_min   = in_min;
+    seg[s].out_min  = out_min;
+    seg[s].slope    = d_in?((d_out << 24) + d_in - 1) / d_in:0;
+    seg[s].r_slope  = d_out?(d_in << 17) / d_out:0;
+}
+
+// floor((x * m + add) / 2^shift) by two 16x16 multiplies, x is 12-bit, add < 2^20, shift >= 16
+uint32_t HOTGUN_CFG::mulShift(uint16_t x, uint32_t m, uint32_t add, uint8_t shift) {
+    uint32_t lo = uint32_t(x) * uint16_t(m) + add;
+    uint32_t hi = uint32_t(x) * uint16_t(m >> 16) + (lo >> 16);
+    return hi >> (shift - 16);
 }
 
 void HOTGUN_CFG::save(uint16_t temp, uint16_t fanSpeed) {
@@ -205,43 +291,68 @@ void HOTGUN_CFG::save(uint16_t temp, uint16_t fanSpeed) {
     CONFIG::save();                                                         // Save new data into the EEPROM
 }
 
-void HOTGUN_CFG::applyCalibrationData(uint16_t tip[3]) {
+void HOTGUN_CFG::applyCalibrationData(uint16_t tip[]) {
     if (tip[0] < ambient_temp) {
         uint16_t t = ambient_temp + tip[1];
         tip[0] = t >> 1;
     }
-    t_tip[0] = tip[0];
-    t_tip[1] = tip[1];
-    if (tip[2] > max_temp) tip[2] = max_temp; 
-    t_tip[2] = tip[2];
+    if (tip[calib_points-1] > temp_max) tip[calib_points-1] = temp_max;
+    for (uint8_t i = 0; i < calib_points; ++i)
+        t_tip[i] = tip[i];
+    buildTables();
+}
+
+void HOTGUN_CFG::getCalibrationData(uint16_t tip[]) {
+    for (uint8_t i = 0; i < calib_points; ++i)
+        tip[i] = t_tip[i];
+}
+
+void HOTGUN_CFG::saveCalibrationData(uint16_t tip[]) {
+    if (tip[calib_points-1] > temp_max) tip[calib_points-1] = temp_max;
+    for (uint8_t i = 0; i < calib_points; ++i) {
+        packCalib(Config.calibration, i, tip[i]);
+        t_tip[i] = tip[i];
+    }
+    buildTables();
+}
+
+// The gain schedule points by the calibration
+void HOTGUN_CFG::scheduleTemp(uint16_t temp[3]) {
+    for (uint8_t i = 0; i < 3; ++i)
+        temp[i] = t_sched[i];
+}
+
+void HOTGUN_CFG::schedulePoint(uint16_t &temp, uint16_t &fan) {
+    temp    = t_sched[nearest(t_sched, temp)];
+    fan     = gs_fan[nearest(gs_fan, fan)];
 }
 
-void HOTGUN_CFG::getCalibrationData(uint16_t tip[3]) {
-    tip[0] = t_tip[0];
-    tip[1] = t_tip[1];
-    tip[2] = t_tip[2];
+void HOTGUN_CFG::savePID(uint16_t temp, uint16_t fan, int16_t k[3]) {
+    uint8_t t = nearest(t_sched, temp);
+    uint8_t f = nearest(gs_fan, fan);
+    for (uint8_t i = 0; i < 3; ++i)
+        pid[t][f][i] = k[i];
+    CONFIG::saveFixed((uint8_t *)pid, sizeof(PID_TABLE));                   // Save the schedule into the fixed record
 }
 
-void HOTGUN_CFG::saveCalibrationData(uint16_t tip[3]) {
-    if (tip[2] > max_temp) tip[2] = max_temp;
-    uint32_t cd = tip[2] & 0x3FF; cd <<= 10;                                // Pack tip calibration data in one 32-bit word: 10-bits per value
-    cd |= tip[1] & 0x3FF; cd <<= 10;
-    cd |= tip[0];
-    Config.calibration = cd;
-    t_tip[0] = tip[0];
-    t_tip[1] = tip[1];
-    t_tip[2] = tip[2];
+uint8_t HOTGUN_CFG::nearest(const uint16_t point[3], uint16_t value) {
+    uint8_t n = 0;
+    for (uint8_t i = 1; i < 3; ++i)
+        if (abs(int(value) - int(point[i])) < abs(int(value) - int(point[n]))) n = i;
+    return n;
 }
 
 void HOTGUN_CFG::setDefaults(bool Write) {
-    uint32_t c = def_tip[2] & 0x3FF; c <<= 10;
-    c |= def_tip[1] & 0x3FF;         c <<= 10;
-    c |= def_tip[0] & 0x3FF;
-    Config.calibration  = c;
+    memset(Config.calibration, 0, sizeof(Config.calibration));
+    for (uint8_t i = 0; i < calib_points; ++i)
+        packCalib(Config.calibration, i, defaultReading(calib_tip[i]));
     Config.temp         = def_temp;
     Config.fan          = def_fan;
     Config.dspl_bright  = def_br;
+    memset(pid, 0, sizeof(PID_TABLE));                                      // The factory PID gain schedule
+    memset(Config.power, 0, sizeof(PWR_TABLE));                             // The factory steady-state power
     if (Write) {
         CONFIG::save();
+        CONFIG::saveFixed((uint8_t *)pid, sizeof(PID_TABLE));
     }
 }
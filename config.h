@@ -9,15 +9,26 @@
 //------------------------------------------ Configuration data ------------------------------------------------
 /* Config record in the EEPROM has the following format:
  * uint32_t ID                           each time increment by 1
- * struct cfg                            config data, 9 bytes
- * byte CRC                              the checksum
+ * byte version                          the record layout version, cfg_version
+ * struct cfg                            config data, 26 bytes
+ * byte CRC                              CRC8 of the record
+ * The records of 32 bytes are written in turn to level the wear, 30 records fit the 1 KB EEPROM.
+ * The rarely written data (the PID gain schedule found by the auto-tune) is kept in the fixed record
+ * at the end of the EEPROM (fixed_size bytes) that is not the part of the ring:
+ * byte version                          the record layout version, cfg_version
+ * data                                  up to fixed_size - 2 bytes
+ * byte CRC                              CRC8 of the version and the data
 */
+const uint8_t   cfg_version = 1;                                            // Change it when the layout of the records changes
+
 struct cfg {
-    uint32_t    calibration;                                                // Packed calibration data by three temperature points
+    uint8_t     calibration[(max_calib_points * 3) / 2];                    // The internal readings at calib_tip points, packed by 12 bits
     uint16_t    temp;                                                       // The preset temperature of the IRON in internal units
     uint16_t    fan;                                                        // The preset fan speed 0 - max_fan_speed
     uint8_t     dspl_bright;                                                // The display brightness
+    PWR_TABLE   power;                                                      // The learned steady-state power, zero - factory value
 };
+static_assert(sizeof(struct cfg) + 6 <= 32, "The config record does not fit 32 bytes");
 
 class CONFIG {
     public:
@@ -27,7 +38,7 @@ class CONFIG {
             rAddr = wAddr = 0;
             eLength       = 0;
             nextRecID     = 0;
-            uint8_t rs = sizeof(struct cfg) + 5;                             // The total config record size
+            uint8_t rs = sizeof(struct cfg) + 6;                             // The total config record size
             // Select appropriate record size; The record size should be power of 2, i.e. 8, 16, 32, 64, ... bytes
             for (record_size = 8; record_size < rs; record_size <<= 1);
         }
@@ -37,20 +48,31 @@ class CONFIG {
         void updateConfig(struct cfg &Cfg);                                 // Copy updated config into this class
         bool save(void);                                                    // Save current config copy to the EEPROM
         bool saveConfig(struct cfg &Cfg);                                   // write updated config into the EEPROM
+        bool loadFixed(uint8_t *data, uint8_t size);                        // Read the fixed record at the end of the EEPROM
+        void saveFixed(const uint8_t *data, uint8_t size);                  // Write the fixed record, only the changed bytes
+        static constexpr uint8_t fixed_size = 64;                           // The size of the fixed record area
     protected:
         struct   cfg Config;
     private:
         bool     readRecord(uint16_t addr, uint32_t &recID);
+        static uint8_t crc8(uint8_t crc, uint8_t data);                     // Dallas/Maxim CRC8 update
         bool     can_write;                                                 // The flag indicates that data can be saved
         uint8_t  buffRecords;                                               // Number of the records in the outpt buffer
         uint16_t rAddr;                                                     // Address of thecorrect record in EEPROM to be read
         uint16_t wAddr;                                                     // Address in the EEPROM to start write new record
-        uint16_t eLength;                                                   // Length of the EEPROM, depends on arduino model
+        uint16_t eLength;                                                   // Length of the record ring: the EEPROM except the fixed record
         uint32_t nextRecID;                                                 // next record ID
         uint8_t  record_size;                                               // The size of one record in bytes
 };
 
 //------------------------------------------ class HOT GUN CONFIG ----------------------------------------------
+/* The calibration is the monotone piecewise linear curve through the ambient temperature and the reference points
+ * (calib_tip), the last segment is extended above the last point. Each segment keeps the fixed-point slope and
+ * the reciprocal slope, rebuilt when the calibration changes (see buildTables()), so both conversions take
+ * two 16x16 multiplies and no divide. tempHuman() is bit-exact with the map() of the segment: the slope is rounded up with 24
+ * fraction bits, that is exact while the internal units are 12-bit and the Celsius span of the segment is
+ * less than 256. tempInternal() returns the lowest internal temperature that reads the given Celsius value.
+ */
 class HOTGUN_CFG : public CONFIG {
     public:
         HOTGUN_CFG()                                                        { }
@@ -62,19 +84,44 @@ class HOTGUN_CFG : public CONFIG {
         uint8_t     dsplBright(void)                                        { return Config.dspl_bright; }
         void        saveBright(uint8_t br)                                  { Config.dspl_bright = br;   }
         void        save(uint16_t temp, uint16_t fanSpeed);                 // Save preset temperature in the internal units and fan speed
-        void        applyCalibrationData(uint16_t tip[3]);
-        void        getCalibrationData(uint16_t tip[3]);
-        void        saveCalibrationData(uint16_t tip[3]);
+        void        applyCalibrationData(uint16_t tip[]);                   // The internal readings at calib_tip points
+        void        getCalibrationData(uint16_t tip[]);
+        void        saveCalibrationData(uint16_t tip[]);
+        const PID_TABLE* pidTable(void)                                     { return &pid;               }
+        void        scheduleTemp(uint16_t temp[3]);                         // The temperature points of the gain schedule in internal units
+        void        schedulePoint(uint16_t &temp, uint16_t &fan);           // Move the temperature and the fan speed to the nearest gain schedule point
+        void        savePID(uint16_t temp, uint16_t fan, int16_t k[3]);     // Save the PID coefficients into the nearest point of the gain schedule
+        const PWR_TABLE* powerTable(void)                                   { return &Config.power;      }
+        void        savePower(PWR_TABLE &pwr)                               { memcpy(Config.power, pwr, sizeof(PWR_TABLE)); }
         void        setDefaults(bool Write);                                // Set default parameter values if failed to load data from EEPROM
     private:
-        uint16_t t_tip[3];
-        const   uint16_t def_tip[3] = {587, 751, 850};                      // Default values of internal sensor readings at reference temperatures
-        const   uint16_t min_temp   = 50;
-        const   uint16_t max_temp   = 900;
-        const   uint16_t def_temp   = 600;                                  // Default preset temperature
+        struct SEGMENT {
+            uint16_t    in_min;                                             // The internal temperature of the segment start
+            uint16_t    out_min;                                            // The Celsius temperature of the segment start
+            uint32_t    slope;                                              // Celsius per internal unit << 24, rounded up
+            uint32_t    r_slope;                                            // Internal units per Celsius << 17, rounded down
+        };
+        uint8_t     nearest(const uint16_t point[3], uint16_t value);
+        void        buildTables(void);                                      // Build the conversion segments by the calibration data
+        void        buildSegment(uint8_t s, uint16_t in_min, uint16_t in_max, uint16_t out_min, uint16_t out_max);
+        static uint32_t mulShift(uint16_t x, uint32_t m, uint32_t add, uint8_t shift);
+        bool        validCalibration(void);
+        void        validTables(void);                                      // Replace the out of range table values by the factory ones
+        static uint16_t unpackCalib(const uint8_t c[], uint8_t i);          // The 12-bit calibration value i of the packed config data
+        static void packCalib(uint8_t c[], uint8_t i, uint16_t value);
+        uint16_t    defaultReading(uint16_t tempC);                         // The internal reading by the default calibration
+        uint16_t    t_tip[max_calib_points];                                // The internal readings at calib_tip points
+        uint16_t    t_sched[3];                                             // The gain schedule points (temp_tip) in internal units
+        SEGMENT     seg[max_calib_points];                                  // Ambient - tip[0], tip[0] - tip[1], ..., above the last tip
+        PID_TABLE   pid;                                                    // The PID gain schedule found by the auto-tune, zero - factory coefficient (the fixed record)
+        const   uint16_t def_tip[3] = {2348, 3004, 3400};                   // Default internal sensor readings at 200, 300 and 400 Celsius
+        const   uint16_t min_temp   = 200;
+        const   uint16_t max_temp   = temp_max;                             // See vars.cpp
+        const   uint16_t def_temp   = 2400;                                 // Default preset temperature
         const   uint16_t def_fan    = 200;                                  // Default preset fan speed 0 - max_fan_speed
         const   uint8_t  def_br     = 128;                                  // Default display brightness
-        const   uint16_t ambient_temp = 67;
+        const   uint8_t  max_power  = 99;                                   // The maximum steady-state power, see PWR_MODEL
+        const   uint16_t ambient_temp = 268;
         const   uint16_t ambient_tempC= 25;
 };
 
@@ -14,7 +14,7 @@ void DSPL::init(void) {
 }
 
 void DSPL::tSet(uint16_t t, bool Celsius) {
-    char buff[10];
+    char buff[12];
     if (Celsius) {
         temp_units = 'C';
     } else {
@@ -44,7 +44,7 @@ void DSPL::tCurr(uint16_t t, bool Celsius) {
 void DSPL::tInternal(uint16_t t) {
     char buff[6];
     LiquidCrystal_I2C::setCursor(0, 1);
-    if (t < 1023) {
+    if (t < 4095) {
         sprintf(buff, "%4d ", t);
     } else {
         LiquidCrystal_I2C::print(F("xxxx"));
@@ -63,7 +63,7 @@ void DSPL::calibReady(bool on) {
 }
 
 void DSPL::fanSpeed(uint16_t s) {
-    char buff[6];
+    char buff[9];
     s = map(s, 0, max_fan_speed, 0, 99);
     sprintf(buff, " %c%2d%c", (char)2, s, '%');
     LiquidCrystal_I2C::setCursor(11, 1);
@@ -90,16 +90,22 @@ void DSPL::setupMode(byte mode) {
         case 0:                                                             // tip calibrate
             LiquidCrystal_I2C::print(F("calibrate"));
             break;
-        case 1:                                                             // tune
+        case 1:                                                             // calibrate by the reference thermometer
+            LiquidCrystal_I2C::print(F("auto calib"));
+            break;
+        case 2:                                                             // tune
             LiquidCrystal_I2C::print(F("tune"));
             break;
-        case 2:                                                             // save
+        case 3:                                                             // PID auto-tune
+            LiquidCrystal_I2C::print(F("auto tune"));
+            break;
+        case 4:                                                             // save
             LiquidCrystal_I2C::print(F("save"));
             break;
-        case 3:                                                             // cancel
+        case 5:                                                             // cancel
             LiquidCrystal_I2C::print(F("cancel"));
             break;
-        case 4:                                                             // set defaults
+        case 6:                                                             // set defaults
             LiquidCrystal_I2C::print(F("reset config"));
             break;
         default:
@@ -123,6 +129,14 @@ void DSPL::msgReady(void) {
     LiquidCrystal_I2C::print(F(" Ready"));
 }
 
+void DSPL::msgTimeLeft(uint16_t s) {
+    char buff[7];
+    if (s > 999) s = 999;
+    LiquidCrystal_I2C::setCursor(10, 0);
+    sprintf(buff, " ~%3ds", s);
+    LiquidCrystal_I2C::print(buff);
+}
+
 void DSPL::msgCold(void) {
     LiquidCrystal_I2C::setCursor(10, 0);
     LiquidCrystal_I2C::print(F("  Cold"));
@@ -138,3 +152,29 @@ void DSPL::msgTune(void) {
     LiquidCrystal_I2C::print(F("Tune"));
 }
 
+void DSPL::msgAutoTune(uint8_t cycle, uint8_t total) {
+    char buff[13];                                                          // "Auto 255/255"
+    LiquidCrystal_I2C::setCursor(0, 0);
+    sprintf(buff, "Auto %d/%d", cycle, total);
+    LiquidCrystal_I2C::print(buff);
+}
+
+void DSPL::msgAutoCalib(uint8_t point, uint8_t total, uint16_t t) {
+    char buff[16];                                                          // "255/255 65535", the degree sign and the units
+    LiquidCrystal_I2C::setCursor(0, 0);
+    if (t > 999) t = 999;                                                   // Keep clear of the ON/OFF message
+    sprintf(buff, "%d/%d %3d%c%c", point, total, t, (char)1, temp_units);
+    LiquidCrystal_I2C::print(buff);
+}
+
+void DSPL::pidGains(int16_t kp, int16_t ki, int16_t kd) {
+    char buff[22];                                                          // Three int16 values of 6 characters
+    LiquidCrystal_I2C::setCursor(0, 1);
+    kp = constrain(kp, 0, 32767);                                           // Keep the line 16 characters wide
+    ki = constrain(ki, 0, 9999);
+    kd = constrain(kd, 0, 32767);
+    sprintf(buff, "%5d %4d %5d", kp, ki, kd);
+    LiquidCrystal_I2C::print(buff);
+    full_second_line = true;
+}
+
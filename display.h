@@ -22,9 +22,13 @@ class DSPL : protected LiquidCrystal_I2C {
         void    msgON(void);                                                // Show message: "ON"
         void    msgOFF(void);
         void    msgReady(void);
+        void    msgTimeLeft(uint16_t s);                                    // Show the time to the 'Ready' state, s
         void    msgCold(void);
         void    msgFail(void);                                              // Show 'Fail' message
         void    msgTune(void);                                              // Show 'Tune' message
+        void    msgAutoTune(uint8_t cycle, uint8_t total);                  // Show 'Auto' message and the relay cycle
+        void    msgAutoCalib(uint8_t point, uint8_t total, uint16_t t);     // Show the reference point being calibrated
+        void    pidGains(int16_t kp, int16_t ki, int16_t kd);               // Show the PID coefficients in the second line
     private:
         bool    full_second_line	= false;								// Whether the second line is full with the message
         char    temp_units			= 'C';
@@ -1,7 +1,8 @@
 #include "encoder.h"
+#include "trace.h"
 
 //------------------------------------------ class BUTTON ------------------------------------------------------
-BUTTON::BUTTON(uint8_t b_pin, uint16_t to = 3000) : avg(4) {
+BUTTON::BUTTON(uint8_t b_pin, uint16_t to) {
     this->b_pin = b_pin; 
     setTimeout(to);
 }
@@ -13,12 +14,12 @@ BUTTON::BUTTON(uint8_t b_pin, uint16_t to = 3000) : avg(4) {
  * 2    - long press
  */
 uint8_t BUTTON::buttonCheck(void) {
-static uint32_t old_ms = 0;
     if (millis() >= b_check) {                                  // It is time to check the button status
-//Serial.print("b check "); Serial.print(millis() - old_ms); Serial.print(" "); old_ms = millis();
         b_check = millis() + b_check_period;
         uint8_t s = 0;
-        if (!digitalRead(b_pin))                               // if port state is low, the button pressed
+        uint8_t b_level = digitalRead(b_pin);
+        TRACE_LEVEL(EVENT_TRACE::EV_BUTTON, b_level);
+        if (!b_level)                                          // if port state is low, the button pressed
             s = trigger_on << 1;
         if (b_on) {
             if (avg.average(s) < trigger_off)
@@ -88,8 +89,8 @@ uint8_t BUTTON::buttonTick(void) {
 }
 
 //------------------------------------------ class ENCODER ------------------------------------------------------
-RENC::RENC(uint8_t main_pin, uint8_t slave_pin, uint8_t button_pin, int16_t init_pos) : BUTTON(button_pin) {
-    pt = 0; m_pin = main_pin; s_pin = slave_pin; pos = init_pos;
+RENC::RENC(uint8_t main_pin, uint8_t slave_pin, uint8_t button_pin, int16_t init_pos) : BUTTON(button_pin), pos(init_pos) {
+    pt = 0; m_pin = main_pin; s_pin = slave_pin;
     min_pos = -32767; max_pos = 32766; ch_b = false; increment = 1; fast_increment = 1;
     changed = 0;
     is_looped = false;
@@ -103,22 +104,25 @@ void RENC::init(void) {
 
 bool RENC::write(int16_t init_pos) {
     if ((init_pos >= min_pos) && (init_pos <= max_pos)) {
-        pos = init_pos;
+        pos.set(init_pos);
         return true;
     }
     return false;
 }
 
 void RENC::reset(int16_t init_pos, int16_t low, int16_t upp, uint8_t inc, uint8_t fast_inc, bool looped) {
+    if (fast_inc < inc) fast_inc = inc;
+    noInterrupts();                                             // The interrupt handler reads the limits
     min_pos = low; max_pos = upp;
-    if (!write(init_pos)) init_pos = min_pos;
-    increment = fast_increment = inc;
-    if (fast_inc > increment) fast_increment = fast_inc;
+    increment = inc; fast_increment = fast_inc;
     is_looped = looped;
+    interrupts();
+    write(init_pos);
 }
 
 void RENC::encoderIntr(void) {                                  // Interrupt function, called when the channel A of encoder changed
     bool rUp = digitalRead(m_pin);
+    TRACE_EVENT(EVENT_TRACE::EV_ENCODER, (rUp?1:0) | (digitalRead(s_pin)?2:0));
     unsigned long now_t = millis();
     if (!rUp) {                                                 // The channel A has been "pressed"
         if ((pt == 0) || (now_t - pt > over_press)) {
@@ -131,19 +135,21 @@ void RENC::encoderIntr(void) {                                  // Interrupt fun
             if ((now_t - pt) < over_press) {
                 if ((now_t - changed) < fast_timeout) inc = fast_increment;
                 changed = now_t;
-                if (ch_b) pos -= inc; else pos += inc;
-                if (pos > max_pos) { 
+                int32_t p = pos.isrRead();
+                if (ch_b) p -= inc; else p += inc;
+                if (p > max_pos) { 
                     if (is_looped)
-                        pos = min_pos;
+                        p = min_pos;
                     else 
-                        pos = max_pos;
+                        p = max_pos;
                 }
-                if (pos < min_pos) {
+                if (p < min_pos) {
                     if (is_looped)
-                        pos = max_pos;
+                        p = max_pos;
                     else
-                        pos = min_pos;
+                        p = min_pos;
                 }
+                pos.write(p);
             }
             pt = 0; 
         }
@@ -2,6 +2,7 @@
 #define _ENCODER_H_
 #include <Arduino.h>
 #include "stat.h"
+#include "snapshot.h"
 
 //------------------------------------------ class BUTTON ------------------------------------------------------
 class BUTTON {
@@ -13,7 +14,7 @@ class BUTTON {
         void        init(void)                              { pinMode(b_pin, INPUT_PULLUP); }
     private:
         uint8_t     buttonTick(void);
-        EMP_AVERAGE         avg;                            // Do average the button readings to mainain the button status
+        EMP_SHIFT<2>        avg;                            // Do average the button readings to mainain the button status, length 4
         uint16_t            over_press;                     // Maximum time in ms the button can be pressed
         volatile bool       i_b_rel         = false;        // Ignore button release event
         bool                b_on            = false;        // The button current position: true - pressed
@@ -24,7 +25,6 @@ class BUTTON {
         uint16_t            tick_period     = 0;            // Repeat 'tick' period
         const uint8_t       trigger_on      = 100;          // avg limit to change button status to on
         const uint8_t       trigger_off     = 50;           // avg limit to change button status to off
-        const uint8_t       avg_length      = 4;            // avg length
         const uint8_t       b_check_period  = 20;           // The button check period, ms
         const uint16_t      long_press      = 1500;         // If the button was pressed more that this timeout, we assume the long button press
         const uint16_t      def_over_press  = 2500;         // Default value for button overpress timeout (ms)
@@ -37,7 +37,7 @@ class RENC : public BUTTON {
         void        init(void);
         void        set_increment(uint8_t inc)      { increment = inc; }
         uint8_t     get_increment(void)             { return increment; }
-        int16_t     read(void)                      { return pos; }
+        int16_t     read(void)                      { return pos.read(); }
         void        reset(int16_t init_pos, int16_t low, int16_t upp, uint8_t inc = 1, uint8_t fast_inc = 0, bool looped = false);
         bool        write(int16_t initPos);
         void        encoderIntr(void);
@@ -50,7 +50,7 @@ class RENC : public BUTTON {
         volatile uint32_t   pt;                     // Time in ms when the encoder was rotaded
         volatile uint32_t   changed;                // Time in ms when the value was changed
         volatile bool       ch_b;
-        volatile int16_t    pos;                    // Encoder current position
+        SNAPSHOT<int16_t>   pos;                    // Encoder current position, changed by the interrupt
         const uint16_t      fast_timeout    = 300;  // Time in ms to change encoder quickly
         const uint16_t      over_press      = 1000;
 };
@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include "gun.h"
 #include "vars.h"
+#include "trace.h"
 
 //------------------------------------------ class PID algoritm to keep the temperature -----------------------
 void PID::resetPID(int temp) {
@@ -8,54 +9,211 @@ void PID::resetPID(int temp) {
     power  = 0;
     i_summ = 0;
     pid_iterate = false;
-    if ((temp > 0) && (temp < 1000))
+    warm   = true;
+    if ((temp > 0) && (temp < 4096))
         temp_h1 = temp;
     else
         temp_h1 = 0;
 }
 
 int PID::changePID(uint8_t p, int k) {
+    if (k > PID_Q13::gain_max) k = PID_Q13::gain_max;
+    if (k >= 0) scheduled = false;                                          // The coefficients set manually
     switch(p) {
         case 1:
             if (k >= 0) Kp = k;
-            return Kp;
+            k = Kp;
+            break;
         case 2:
-            if (k >= 0) Ki = k;
-            return Ki;
+            if (k >= 0) {
+                Ki = k;
+                summ_limit = PID_Q13::summLimit(Ki);                        // The only divide, when the coefficient changed
+            }
+            k = Ki;
+            break;
         case 3:
             if (k >= 0) Kd = k;
-            return Kd;
+            k = Kd;
+            break;
         default:
-        break;
+            return 0;
+    }
+    return k;
+}
+
+void PID::controlRate(uint8_t r) {
+    if (r == 0) r = 1;
+    rate = r;
+    PID_Q13::reciprocal(rate, r_mul, r_shift);
+    resetPID();
+}
+
+void PID::gainSchedule(const PID_TABLE *table, const uint16_t temp[3]) {
+    gs_table = table;
+    for (uint8_t i = 0; i < 3; ++i)
+        gs_temp[i] = temp[i];
+    scheduled   = true;
+    sched_temp  = 0;                                                        // Recalculate the coefficients
+    sched_fan   = 0;
+}
+
+// The segment between the schedule points and the position of the value in it, 0-128
+static uint8_t scheduleSegment(const uint16_t point[3], uint16_t value, uint8_t &frac) {
+    if (value <= point[0]) {
+        frac = 0;
+        return 0;
+    }
+    if (value >= point[2]) {
+        frac = 128;
+        return 1;
+    }
+    uint8_t i = (value < point[1])?0:1;
+    frac = (uint32_t(value - point[i]) << 7) / (point[i+1] - point[i]);
+    return i;
+}
+
+int16_t PID::scheduleCell(uint8_t t, uint8_t f, uint8_t k) {
+    int16_t g = gs_table?(*gs_table)[t][f][k]:0;
+    if (g == 0) g = pid_schedule[t][f][k];
+    return g;
+}
+
+// Bilinear interpolation by the preset temperature and the fan speed, when one of them changed
+void PID::scheduleGains(uint16_t temp_set, uint16_t fan) {
+    if (!scheduled || (temp_set == sched_temp && fan == sched_fan)) return;
+    sched_temp  = temp_set;
+    sched_fan   = fan;
+    uint8_t ft, ff;
+    uint8_t t = scheduleSegment(gs_temp, temp_set, ft);
+    uint8_t f = scheduleSegment(gs_fan, fan, ff);
+    int16_t g[3];
+    for (uint8_t k = 0; k < 3; ++k) {
+        int32_t lo = int32_t(scheduleCell(t,   f, k)) * (128 - ff) + int32_t(scheduleCell(t,   f+1, k)) * ff;
+        int32_t hi = int32_t(scheduleCell(t+1, f, k)) * (128 - ff) + int32_t(scheduleCell(t+1, f+1, k)) * ff;
+        g[k] = (lo * (128 - ft) + hi * ft + 8192) >> 14;
+    }
+    setGains(g[0], g[1], g[2]);
+}
+
+void PID::setGains(int16_t kp, int16_t ki, int16_t kd) {
+    Kp = kp;
+    Kd = kd;
+    if (Ki != ki) {
+        Ki = ki;
+        summ_limit = PID_Q13::summLimit(Ki);
     }
-    return 0;
 }
 
 long PID::reqPower(int temp_set, int temp_curr) {
     if (temp_h0 == 0) {
         // When the temperature is near the preset one, reset the PID and prepare iterative formula                        
-        if ((temp_set - temp_curr) < 30) {
+        if ((temp_set - temp_curr) < 120) {
             if (!pid_iterate) {
                 pid_iterate = true;
                 power = 0;
                 i_summ = 0;
             }
         }
-        i_summ += temp_set - temp_curr;                                     // first, use the direct formula, not the iterate process
-        power = Kp*(temp_set - temp_curr) + Ki*i_summ;
+        if ((temp_set - temp_curr) > warm_band)                            // The heat stored by the full power heating replaces the model power
+            warm = false;
+        i_summ = PID_Q13::integrate(i_summ, temp_set - temp_curr, summ_limit);  // first, use the direct formula, not the iterate process
+        if (rate > 1)
+            power = PID_Q13::direct(Kp, Ki, temp_set - temp_curr, i_summ, rate);
+        else
+            power = PID_Q13::direct(Kp, Ki, temp_set - temp_curr, i_summ);
+        if (warm) power = PID_Q13::add(power, ff_power);                    // Started near the preset temperature
     // If the temperature is near, prepare the PID iteration process
     } else {
-        long kp = Kp * (temp_h1 - temp_curr);
-        long ki = Ki * (temp_set - temp_curr);
-        long kd = Kd * (temp_h0 + temp_curr - 2*temp_h1);
-        long delta_p = kp + ki + kd;
-        power += delta_p;                                                   // power kept multiplied by denominator!
+        int32_t delta_p;
+        if (rate > 1)
+            delta_p = PID_Q13::delta(Kp, Ki, Kd, temp_set, temp_curr, temp_h0, temp_h1, rate);
+        else
+            delta_p = PID_Q13::delta(Kp, Ki, Kd, temp_set, temp_curr, temp_h0, temp_h1);
+        power = PID_Q13::add(power, delta_p);                               // power kept multiplied by denominator!
     }
     if (pid_iterate) temp_h0 = temp_h1;
     temp_h1 = temp_curr;
-    long pwr = power + (1 << (denominator_p-1));                            // prepare the power to delete by denominator, round the result
-    pwr >>= denominator_p;                                                  // delete by the denominator
-    return pwr;
+    return PID_Q13::output(power, rate, r_mul, r_shift);                    // delete by the denominator, round the result
+}
+
+// Shift the iterative power by the steady-state power change (or by the part of it), the integrator makes the rest
+void PID::feedForward(uint8_t p, uint8_t shift) {
+    int32_t ff = PID_Q13::scale(p) * rate;
+    if (temp_h0 != 0)
+        power = PID_Q13::add(power, (ff - ff_power) >> shift);
+    ff_power = ff;
+}
+
+//------------------------------------------ class PWR_MODEL: the steady-state power of the Hot Air Gun --------
+void PWR_MODEL::init(const PWR_TABLE *table, const uint16_t temp[3]) {
+    for (uint8_t t = 0; t < 3; ++t) {
+        pt[t] = temp[t];
+        for (uint8_t f = 0; f < 3; ++f) {
+            uint8_t p = table?(*table)[t][f]:0;
+            if (p == 0) p = ff_power[t][f];
+            pwr[t][f] = uint16_t(p) << 8;
+        }
+    }
+    for (uint8_t e = 0; e < 2; ++e) {                                       // The edge points are above the ambient reading
+        uint16_t edge = (pt[e*2] > 256)?pt[e*2]:257;
+        r_edge[e] = (1UL << 24) / edge;
+    }
+}
+
+// The interpolation cells and their weights (the summ is 16384). Outside of the temperature points returns the edge point
+uint16_t PWR_MODEL::cells(uint16_t temp, uint16_t fan, uint8_t &t, uint8_t &f, uint16_t w[4]) {
+    uint8_t ft, ff;
+    t = scheduleSegment(pt, temp, ft);
+    f = scheduleSegment(gs_fan, fan, ff);
+    w[0] = (128 - ft) * (128 - ff);
+    w[1] = (128 - ft) * ff;
+    w[2] = ft * (128 - ff);
+    w[3] = ft * ff;
+    if (temp < pt[0]) return pt[0];
+    if (temp > pt[2]) return pt[2];
+    return 0;
+}
+
+uint16_t PWR_MODEL::interpolate(uint8_t t, uint8_t f, const uint16_t w[4]) {
+    return (uint32_t(pwr[t][f]) * w[0] + uint32_t(pwr[t][f+1]) * w[1] +
+            uint32_t(pwr[t+1][f]) * w[2] + uint32_t(pwr[t+1][f+1]) * w[3]) >> 14;
+}
+
+uint8_t PWR_MODEL::power(uint16_t temp, uint16_t fan) {
+    uint8_t  t, f;
+    uint16_t w[4];
+    uint16_t edge = cells(temp, fan, t, f, w);
+    uint32_t p = interpolate(t, f, w);
+    if (edge) {                                                             // The power is proportional to the temperature
+        uint32_t ratio = (uint32_t(temp) * r_edge[(edge == pt[0])?0:1]) >> 12;  // temp / edge << 12, by the reciprocal
+        p = (p * ratio) >> 12;
+    }
+    p = (p + 128) >> 8;
+    if (p > max_power) p = max_power;
+    return p;
+}
+
+// The gradient step: every cell moves by the error multiplied by its weight
+void PWR_MODEL::learn(uint16_t temp, uint16_t fan, uint8_t power) {
+    if (temp == 0) return;
+    uint8_t  t, f;
+    uint16_t w[4];
+    uint16_t edge = cells(temp, fan, t, f, w);
+    int32_t target = int32_t(power) << 8;
+    if (edge) target = target * edge / temp;                                // The power at the edge point
+    int32_t p = interpolate(t, f, w);
+    int32_t e = target - p;
+    for (uint8_t i = 0; i < 4; ++i) {
+        uint16_t &c = pwr[t + (i >> 1)][f + (i & 1)];
+        int32_t v = c + ((e * w[i]) >> (14 + learn_shift));
+        c = constrain(v, 0, int32_t(max_power) << 8);
+    }
+}
+
+void PWR_MODEL::table(PWR_TABLE &p) {
+    for (uint8_t t = 0; t < 3; ++t)
+        for (uint8_t f = 0; f < 3; ++f)
+            p[t][f] = (pwr[t][f] + 128) >> 8;
 }
 
 //--------------------- High frequency PWM signal class on D9 pin -----------------------------------------
@@ -73,6 +231,17 @@ void FastPWM_D9::init(void) {
     interrupts();
 }
 
+void FastPWM_D9::ramp(uint16_t d) {
+    uint16_t c = OCR1A;
+    if (max_step == 0 || c < min_fan_speed || d < min_fan_speed) {		// Start or stop the fan immediately
+        OCR1A = d;
+    } else if (d > c) {
+        OCR1A = (d - c > max_step)?c + max_step:d;
+    } else {
+        OCR1A = (c - d > max_step)?c - max_step:d;
+    }
+}
+
 //--------------------- Hot air gun manager using complete sine shape to power on the hardware ---------------
 
 HOTGUN_HW::HOTGUN_HW(uint8_t HG_sen_pin, uint8_t HG_pwr_pin, uint8_t HG_ac_relay_pin) {
@@ -83,14 +252,29 @@ HOTGUN_HW::HOTGUN_HW(uint8_t HG_sen_pin, uint8_t HG_pwr_pin, uint8_t HG_ac_relay
 
 void HOTGUN_HW::init(void) {
     cnt             = 0;
+    ctrl_cnt        = ctrl_period;
+    p_acc           = 0;
+    period_end      = false;
     actual_power    = 0;
     active          = false;
+    sd_acc          = 0;
     pinMode(sen_pin, INPUT);
+    adc_summ        = 0;
+    adc_cnt         = 0;
+    ADMUX   = (sen_pin - A0) & 0x07;                        // REFS1:0 = 00, the external reference on AREF (see setup()), the sensor channel
+    ADCSRB  = 0;                                            // The free running mode
+    ADCSRA  = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);    // 16 MHz / 128, 104 us per conversion
+    adc_tagged      = false;
+    phase_cnt       = 0;
+    TCCR0A &= ~(_BV(WGM01) | _BV(WGM00));                   // Timer0 normal mode: OCR0A is written at once, not at BOTTOM as in fast PWM;
+                                                            // the overflow (millis()) is every 256 ticks still, no PWM is used on D5, D6
+    TIMSK0 &= ~_BV(OCIE0A);                                 // Armed by syncCB()
     pinMode(gun_pin, OUTPUT);
     digitalWrite(gun_pin, LOW);
     pinMode(ac_relay_pin, OUTPUT);
     digitalWrite(ac_relay_pin, LOW);
     h_temp.reset();
+    t_spike.reset();
     safetyRelay(false);                                     // Completely turn-off the power of Hot Air Gun
 }
 
@@ -106,22 +290,95 @@ void HOTGUN_HW::safetyRelay(bool activate) {
 }
 
 bool HOTGUN_HW::syncCB(void) {
+    bool switched = false;                                                  // The heater has been switched in this half-period
+    bool ctrl_end = false;
+    half_periods.write(half_periods.isrRead() + 1);
     if (++cnt >= period) {
         cnt = 0;
-        last_period = millis();                                             // Save the current time to check the external interrupts
-        if (!active && (actual_power > 0)) {
-            digitalWrite(gun_pin, HIGH);
-            active = true;
+        last_period.write(millis());                                        // Save the current time to check the external interrupts
+        period_power.write(p_acc);
+        p_acc       = 0;
+        period_end  = true;                                                 // Kept till keepTemp() runs the slow part
+        ctrl_cnt    = ctrl_period;                                          // The control periods are aligned to the power period
+        ctrl_end    = true;
+    } else if (--ctrl_cnt == 0) {
+        ctrl_cnt    = ctrl_period;
+        ctrl_end    = true;
+    }
+    p_acc += actual_power;
+    if (mod == MOD_BURST) {
+        if (cnt == 0) {
+            if (!active && (actual_power > 0)) {
+                digitalWrite(gun_pin, HIGH);
+                active = true;
+                switched = true;
+            }
+        } else if (cnt >= actual_power) {
+            if (active) {
+                digitalWrite(gun_pin, LOW);
+                active = false;
+                switched = true;
+            }
         }
-    } else if (cnt >= actual_power) {
-        if (active) {
-            digitalWrite(gun_pin, LOW);
-            active = false;
+    } else {
+        if ((cnt & 1) == 0) {                                               // Decide once per complete AC sine, no DC current
+            sd_acc += actual_power;
+            bool on = (sd_acc >= period);
+            if (on) sd_acc -= period;
+            if (on != active) {
+                digitalWrite(gun_pin, on?HIGH:LOW);
+                active = on;
+                switched = true;
+            }
         }
     }
-    uint16_t t = analogRead(sen_pin);
-    h_temp.update(t);														// Update hot gun temperature
-    return (cnt == 0);                                                      // End of the Power period (period AC voltage shapes)
+    if (adc_cnt >= adc_samples) {                                           // The burst started by the previous call is complete
+        uint16_t t = (adc_summ + (1 << (adc_shift-1))) >> adc_shift;
+        TRACE_EVENT(EVENT_TRACE::EV_ADC, t);
+        if (!adc_tagged || sample_phase >= switch_settle)                   // Skip the reading inside the switching transient
+            h_temp.update(t_spike.filter(t));								// Update hot gun temperature, the relay and triac spikes removed
+    }
+    adc_summ    = 0;
+    adc_cnt     = 0;
+    adc_tagged  = switched;
+    uint16_t ticks = sample_phase >> 2;                                     // Timer0 ticks by 4 us
+    if (ticks == 0) {
+        ADCSRA |= _BV(ADATE) | _BV(ADSC);                                   // Start the next burst at once
+    } else {
+        OCR0A       = TCNT0 + uint8_t(ticks);                               // The first match in 1-256 ticks
+        phase_cnt   = (ticks - 1) >> 8;
+        TIFR0       = _BV(OCF0A);                                           // Clear the old match
+        TIMSK0     |= _BV(OCIE0A);
+    }
+    return ctrl_end;                                                        // End of the control period (ctrl_period AC voltage shapes)
+}
+
+// Read and clear the flag of the power period end, the flag set by syncCB() is not lost if loop() skips the control period
+bool HOTGUN_HW::powerPeriodEnd(void) {
+    if (!period_end) return false;
+    period_end = false;
+    return true;
+}
+
+void HOTGUN_HW::phaseCB(void) {
+    if (phase_cnt) {
+        --phase_cnt;
+        return;
+    }
+    TIMSK0 &= ~_BV(OCIE0A);
+    ADCSRA |= _BV(ADATE) | _BV(ADSC);                                       // Start the burst at the sample phase
+}
+
+void HOTGUN_HW::samplePhase(uint16_t us) {
+    if (us > sample_phase_max) us = sample_phase_max;
+    sample_phase = us;                                                      // Applied by the next syncCB()
+}
+
+void HOTGUN_HW::adcCB(void) {
+    if (adc_cnt >= adc_samples) return;                                     // The conversion started before the burst was stopped
+    adc_summ += ADC;
+    if (++adc_cnt >= adc_samples)
+        ADCSRA &= ~_BV(ADATE);                                              // Stop the free running mode
 }
 
 void HOTGUN::init(void) {
@@ -132,8 +389,24 @@ void HOTGUN::init(void) {
     HOTGUN_HW::init();
     hg_fan.init();
     h_temp.reset();
-    d_power.length(ec);
-    resetPID();
+    d_power.reset();
+    controlPeriod(ctrl_period);
+}
+
+void HOTGUN::controlPeriod(uint8_t half_periods) {
+    if (half_periods == 0 || period % half_periods) return;
+    ctrl_period = half_periods;
+    ff_temp     = 0;
+    PID::controlRate(period / half_periods);                // Reset the PID also
+    fanSlew(fan_slew);
+}
+
+// The fan is ramped every control period, split the slew rate
+void HOTGUN::fanSlew(uint16_t s) {
+    fan_slew = s;
+    uint16_t step = s / PID::controlRate();
+    if (s > 0 && step == 0) step = 1;
+    hg_fan.slew(step);
 }
 
 uint8_t HOTGUN::avgPowerPcnt(void) {
@@ -148,6 +421,7 @@ uint8_t HOTGUN::avgPowerPcnt(void) {
 }
 
 void HOTGUN::switchPower(bool On) {
+    PowerMode prev = mode;
     fan_off_time = 0;                                       // Disable fan offline by timeout
     switch (mode) {
         case POWER_OFF:
@@ -218,10 +492,30 @@ void HOTGUN::switchPower(bool On) {
         default:
             break;
     }
+    if (mode == POWER_ON && prev != POWER_ON)
+        warmStart();
     h_power.reset();
     d_power.reset();
 }
 
+void HOTGUN::warmStart(void) {
+    resetPID(h_temp.read());
+    ff_temp     = 0;                                        // Calculate the feed-forward power by the model
+    ff_fan      = 0;
+    stable_cnt  = 0;
+    approach.reset();
+}
+
+void HOTGUN::learnPower(uint16_t t) {
+    if (abs(int(t) - int(temp_set)) > stable_temp || fanSpeed() != fan_speed) {
+        stable_cnt = 0;
+    } else if (stable_cnt < stable_periods) {
+        ++stable_cnt;
+    } else {
+        pwr_model.learn(temp_set, fan_speed, h_power.read());
+    }
+}
+
 void HOTGUN::fixPower(uint8_t Power) {
     if (Power == 0) {                                       // To switch off the hot gun, set the Power to 0
         switchPower(false);
@@ -229,8 +523,9 @@ void HOTGUN::fixPower(uint8_t Power) {
     }
 
     if (Power > max_power) Power = max_power;
+    if (!isOn())
+        safetyRelay(true);                                  // Supply AC power to the hot air gun socket
     mode = POWER_FIXED;
-    safetyRelay(true);                                      // Supply AC power to the hot air gun socket
     fix_power   = Power;
 }
 
@@ -238,8 +533,9 @@ void HOTGUN::fixPower(uint8_t Power) {
 
 void HOTGUN::keepTemp(void) {
     uint16_t t = h_temp.read();                             // Actual Hot Air Gun temperature
+    bool period_end = powerPeriodEnd();                     // The slow part runs once per power period
 
-    if ((t >= temp_max + 30) || (t > (temp_set + 100))) {  	// Prevent global over heating (see vars.cpp)
+    if ((t >= temp_cutoff) || (t > (temp_set + 400))) {	// Prevent global over heating (see vars.cpp)
         if (mode == POWER_ON) chill = true;                 // Turn off the power in main working mode only;
     }
 
@@ -248,9 +544,9 @@ void HOTGUN::keepTemp(void) {
         case POWER_OFF:
             break;
         case POWER_ON:
-            hg_fan.duty(fan_speed);                         // Turn on the fan immediately
+            hg_fan.ramp(fan_speed);                         // Turn on the fan immediately, change the speed smoothly
             if (chill) {
-                if (t < (temp_set - 2)) {
+                if (t < (temp_set - 8)) {
                     chill = false;
                     resetPID();
                 } else {
@@ -258,15 +554,27 @@ void HOTGUN::keepTemp(void) {
                 }
             }
             if (relay_ready_cnt > 0) {                      // Relay is not ready yet
-                --relay_ready_cnt;                          // Do not apply power to the HOT GUN till AC relay is ready
+                if (period_end) --relay_ready_cnt;          // Do not apply power to the HOT GUN till AC relay is ready
             } else {
+                PID::scheduleGains(temp_set, fan_speed);
+                if (temp_set != ff_temp) {                  // The preset temperature changed, start from the model power
+                    ff_temp = temp_set;
+                    approach.reset();
+                    ff_fan  = fan_speed;
+                    PID::feedForward(pwr_model.power(temp_set, ff_fan), 1);
+                } else if (fan_speed != ff_fan) {          // Compensate the heat loss change by the air flow at once
+                    ff_fan  = fan_speed;
+                    PID::feedForward(pwr_model.power(temp_set, ff_fan), 0);
+                }
                 p = PID::reqPower(temp_set, t);
                 p = constrain(p, 0, max_power);
+                if (period_end)
+                    approach.update(int16_t(temp_set) - int16_t(t));
             }
             break;
         case POWER_FIXED:
             if (relay_ready_cnt > 0) {                      // Relay is not ready yet
-                --relay_ready_cnt;                          // Do not apply power to the HOT GUN till AC relay is ready
+                if (period_end) --relay_ready_cnt;          // Do not apply power to the HOT GUN till AC relay is ready
             } else {
                 p = fix_power;
             }
@@ -295,11 +603,16 @@ void HOTGUN::keepTemp(void) {
 
     // Only supply the power to the heater if the Hot Air Gun is connected
     if (fanSpeed() < min_fan_speed) p = 0;
+    actual_power = constrain(p, 0, period-1);
+    if (!period_end) return;
+
+    p = (periodPower() + (period >> 1)) / period;     // The average power applied in the power period
     h_power.update(p);
     int32_t ap  	= h_power.average(p);
     int32_t diff    = ap - p;
     d_power.update(diff*diff);
-    actual_power = constrain(p, 0, period-1);
+    if (mode == POWER_ON && !chill && relay_ready_cnt == 0)
+        learnPower(t);
     return;
 }
 
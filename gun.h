@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 #include "stat.h"
+#include "snapshot.h"
 #include "vars.h"
+#include "pid.h"
 
 //------------------------------------------ class PID algoritm to keep the temperature -----------------------
 /*  The PID algorithm 
@@ -19,60 +21,185 @@
  *  11/27/2019  [ 2009, 1600,  20]
  *  04/27/2020  [   50,   16,  50]
  */
+typedef PID_KERNEL<13> PID_Q13;												// The coefficients are multiplied by 8192, the same values as Q11 of the 10-bit ADC
+const int16_t	pid_kp		= 50;											// The factory PID coefficients
+const int16_t	pid_ki		= 16;
+const int16_t	pid_kd		= 50;
+
+/*  The PID coefficients depend on the preset temperature and the fan speed: the plant gain and the time constant
+ *  change a lot between 200 Celsius with low air flow and 400 Celsius with the maximum fan speed.
+ *  The gain schedule is the table of the coefficients in the temperature points (temp_tip)
+ *  and the fan speed points (gs_fan), the coefficients are interpolated by both values.
+ *  The factory schedule is used where the table from the EEPROM config has zero coefficient.
+ *  The table is found by hg_tune_pid -t with the smoothness penalty between the neighbouring points, so the
+ *  neighbouring coefficients differ only as much as the plant needs and the interpolated ones are sane.
+ *  At 400 Celsius with the fan 1200 and above the plant is fast and overshoots little, the gains there are raised
+ *  until the 50 Celsius setpoint step settles as fast as with the old common gains; the cold start still overshoots
+ *  less than 1 Celsius. At the lower fan speed the higher Ki overshoots the cold start by 15 Celsius, keep it low.
+ */
+const PID_TABLE	pid_schedule = {											// The factory PID gain schedule
+	{ {  195,  20,    1 }, {  213,  22,    1 }, {  208,  28,    1 } },		// 200 Celsius, fan 600, 1200, 1999
+	{ {  321,  28,    1 }, {  282,  30,    1 }, {  294,  39,    1 } },		// 300 Celsius
+	{ {  343,  28,    1 }, { 1200, 150,    2 }, { 1600, 220,    2 } }		// 400 Celsius
+};
+
+/*  The steady-state power model: the power that keeps the preset temperature at the given fan speed.
+ *  The power is learned in the gain schedule points while the temperature is stable and interpolated between them,
+ *  below the first and above the last temperature point the power is proportional to the temperature.
+ *  The PID starts from the model power (see PID::feedForward()), so the integrator does not find it from scratch.
+ *  The factory table is the steady-state power of the plant model (see host/sim/plant.h), percent.
+ */
+const PWR_TABLE	ff_power	= {												// The factory steady-state power
+	{ 18, 26, 38 },															// 200 Celsius, fan 600, 1200, 1999
+	{ 28, 41, 60 },															// 300 Celsius
+	{ 38, 57, 82 }															// 400 Celsius
+};
+
+class PWR_MODEL {
+    public:
+        PWR_MODEL(void)														{ }
+        void	init(const PWR_TABLE *table, const uint16_t temp[3]);		// The table from the config, zero - the factory power
+        uint8_t	power(uint16_t temp, uint16_t fan);							// The steady-state power, percent
+        void	learn(uint16_t temp, uint16_t fan, uint8_t power);			// Move the model to the measured steady-state power
+        void	table(PWR_TABLE &pwr);										// The learned table rounded to percent
+    private:
+        uint16_t	cells(uint16_t temp, uint16_t fan, uint8_t &t, uint8_t &f, uint16_t w[4]);
+        uint16_t	interpolate(uint8_t t, uint8_t f, const uint16_t w[4]);
+        uint16_t	pwr[3][3];												// The power multiplied by 256
+        uint16_t	pt[3];													// The temperature points in internal units
+        uint16_t	r_edge[2];												// 2^24 divided by the first and the last temperature point
+        const uint8_t	learn_shift	= 4;									// The learning rate is 1/16 of the error
+        const uint8_t	max_power	= 99;
+};
+
 class PID {
     public:
         PID(void) {
-            Kp		= 50;
-            Ki		= 16;
-            Kd		= 50;
+            Kp		= pid_kp;
+            Ki		= pid_ki;
+            Kd		= pid_kd;
+            summ_limit	= PID_Q13::summLimit(Ki);
         }
         void 	resetPID(int temp = -1);									// reset PID algorithm history parameters
         long 	reqPower(int temp_set, int temp_curr);						// Calculate the power to be applied
-        int  	changePID(uint8_t p, int k);								// set or get (if parameter < 0) PID parameter
+        int  	changePID(uint8_t p, int k);								// set or get (if parameter < 0) PID parameter, the schedule is off
+        void	gainSchedule(const PID_TABLE *table, const uint16_t temp[3]);	// Turn on the gain schedule, the temperature points in internal units
+        bool	isScheduled(void)											{ return scheduled; }
+    protected:
+        void	scheduleGains(uint16_t temp_set, uint16_t fan);				// Interpolate the coefficients by the schedule
+        void	feedForward(uint8_t p, uint8_t shift);						// The steady-state power, percent; shift the iterative power by the change >> shift
+        void	controlRate(uint8_t r);										// The PID iterations per power period
+        uint8_t	controlRate(void)											{ return rate; }
     private:
         void  	debugPID(int t_set, int t_curr, long kp, long ki, long kd, long delta_p);
+        void	setGains(int16_t kp, int16_t ki, int16_t kd);
+        int16_t	scheduleCell(uint8_t t, uint8_t f, uint8_t k);
         int   	temp_h0		= 0;											// previously measured temperature
         int 	temp_h1		= 0;
         bool	pid_iterate	= false;										// Whether the iterative process is used
-        long	i_summ		= 0;											// Ki summary multiplied by denominator
-        long	power		= 0;											// The power iterative multiplied by denominator
-        long	Kp, Ki, Kd;													// The PID algorithm coefficients multiplied by denominator
-        const uint8_t denominator_p = 11;									// The common coefficient denominator power of 2 (11 means divide by 2048)
+        bool	warm		= false;										// Whether the PID started near the preset temperature
+        const int16_t	warm_band	= 600;									// The temperature band of the warm start (internal units)
+        int32_t	i_summ		= 0;											// Ki summary, saturated to summ_limit
+        int32_t	summ_limit;													// Maximum Ki summary to keep Ki*i_summ in 32 bits
+        int32_t	power		= 0;											// The power iterative multiplied by denominator
+        int32_t	ff_power	= 0;											// The feed-forward power multiplied by denominator
+        int16_t	Kp, Ki, Kd;													// The PID algorithm coefficients multiplied by denominator
+        uint8_t	rate		= 1;											// The PID iterations per power period
+        uint16_t	r_mul	= 1;											// The reciprocal of the rate (see PID_KERNEL::reciprocal())
+        uint8_t	r_shift		= 0;
+        bool	scheduled	= false;										// Whether the coefficients are calculated by the gain schedule
+        const PID_TABLE	*gs_table	= 0;									// The gain schedule from the config, zero coefficient - factory one
+        uint16_t	gs_temp[3];												// The temperature points of the schedule in internal units
+        uint16_t	sched_temp	= 0;										// The preset temperature the coefficients were calculated for
+        uint16_t	sched_fan	= 0;										// The fan speed the coefficients were calculated for
 };
 
 //--------------------- High frequency PWM signal calss on D9 pin -----------------------------------------
+/*  The fan speed can be changed smoothly: ramp() moves the duty to the preset one by the slew rate every call
+ *  (every control period, see HOTGUN::keepTemp()). The fan is started or stopped immediately. Zero slew rate - no ramp.
+ */
 class FastPWM_D9 {
     public:
         FastPWM_D9()										{ }
         void		init(void);
         void        duty(uint16_t d)						{ OCR1A = d; }
+        void        ramp(uint16_t d);						// Move the duty to the preset one by the slew rate
+        void        slew(uint16_t s)						{ max_step = s; }
         uint16_t    fanSpeed(void)                  		{ return OCR1A; }
+    private:
+        uint16_t	max_step	= 0;						// The maximum duty change per call, zero - immediately
 };
 
 //--------------------- Hot air gun manager using complete sine shape to power on the hardware ---------------
-const uint8_t    hot_gun_hist_length         = 10;  // The history data length of Hot Air Gun average values
+/*  The power is the number of the AC half-periods the heater is on in the power period (100 half-periods).
+ *  In the burst mode the heater is on at the beginning of the period, so the temperature ripples with 1 Hz.
+ *  The sigma-delta mode spreads the complete sine shapes evenly across the period: the power is accumulated
+ *  every sine and the heater is on when the accumulator overflows the period.
+ *  The temperature is controlled every control period (ctrl_period half-periods, the divisor of the power period),
+ *  the sigma-delta modulator applies the new power at once. The burst mode needs the control period of 100.
+ *  syncCB() counts the control periods down and flags the end of the power period; the slow part of keepTemp()
+ *  (the power average, the model learning) runs by the flag, so it stays once per power period when loop()
+ *  misses a control period.
+ *  The PID coefficients are per power period whatever the control period is (see PID::controlRate()).
+ *  The temperature sensor is converted by the ADC in the free running mode: syncCB() starts the burst of adc_samples
+ *  conversions, the conversion complete interrupt (adcCB()) sums them. The next syncCB() decimates the summ of 4^2
+ *  10-bit readings to 12 bits, so the internal temperature units are 0-4095.
+ *  The burst starts at the fixed phase after the AC sync edge, when the switching transient of the triac is over:
+ *  syncCB() arms the Timer0 compare match A interrupt (phaseCB()), Timer0 counts by 4 us for millis(). Timer0 is
+ *  switched to the normal mode, where OCR0A is not double-buffered as in the fast PWM mode of the Arduino core.
+ *  The reading of the half-period the heater has been switched in is tagged as the transition one; when the phase
+ *  is shorter than the switching transient (switch_settle) the tagged readings are not used.
+ */
+const uint8_t    hot_gun_hist_shift          = 3;   // The history data length of Hot Air Gun average power, 2^3 = 8
 class HOTGUN_HW {
     public:
+        typedef enum { MOD_BURST, MOD_SIGMA_DELTA } Modulation;
         HOTGUN_HW(uint8_t HG_sen_pin, uint8_t HG_pwr_pin, uint8_t HG_ac_relay_pin);
         void        init(void);
+        void        modulation(Modulation m)                { mod = m;                                  }
         uint8_t     appliedPower(void)                      { return actual_power;                      }
         uint16_t    tempDispersion(void)                    { return h_temp.dispersion();               }
-        bool        areExternalInterrupts(void)             { return millis() - last_period < period * 15; }
-        bool        syncCB(void);                           // Return true at the end of the power period
+        bool        areExternalInterrupts(void)             { return millis() - last_period.read() < period * 15; }
+        bool        syncCB(void);                           // Return true at the end of the control period
+        void        adcCB(void);                            // The ADC conversion complete interrupt
+        void        phaseCB(void);                          // The Timer0 compare match interrupt: start the ADC burst
+        void        samplePhase(uint16_t us);               // The ADC burst start after the AC sync edge, 0 - at once
+        uint16_t    samplePhase(void)                       { return sample_phase;                      }
+        uint16_t    halfPeriods(void)                       { return half_periods.read();               }   // The AC half-periods counter, wraps
     protected:
-        HIST        h_temp;                                 // Hot Air Gun temperature
+        HIST<int16_t>           h_temp;                     // Hot Air Gun temperature, 12 bits
+        MEDIAN<int16_t, 3>      t_spike;                    // Removes the single reading spikes before h_temp
         void        safetyRelay(bool activate);
+        bool        powerPeriodEnd(void);                   // Whether the power period has ended since the last call
+        uint16_t    periodPower(void)                       { return period_power.read();               }   // The summ of the last power period
         volatile    uint8_t     relay_ready_cnt = 0;        // The relay ready counter, see HOTHUN::power()
         volatile    uint8_t     actual_power;               // Actual power supplied to the heater
         const       uint8_t     period          = 100;
+        uint8_t                 ctrl_period     = 10;       // The control period, half-periods
     private:
         volatile    bool        active;                     // Is the heater active (PWM sigthal phase)
-        volatile    uint32_t    last_period;                // The time in ms when the counter reset
+        SNAPSHOT<uint32_t>      last_period;                // The time in ms when the counter reset
+        SNAPSHOT<uint16_t>      half_periods;               // The AC half-periods counted by syncCB(), 50 or 60 Hz mains
         uint8_t     sen_pin;                                // The temperature sensor pin
         uint8_t     gun_pin;                                // The Hot Gun heater management pin
         uint8_t     ac_relay_pin;                           // The safety relay pin
         uint32_t    check_sw                    = 0;        // Time when check reed switch status (ms)
         volatile    uint8_t     cnt             = 0;        // The AC sine counter (simulate PWM signal)
+        volatile    uint8_t     ctrl_cnt        = 10;       // The half-periods left in the control period
+        volatile    uint16_t    p_acc           = 0;        // The summ of the power of the half-periods in the power period
+        SNAPSHOT<uint16_t>      period_power;               // The summ of the previous power period
+        volatile    bool        period_end      = false;    // The power period has ended, see powerPeriodEnd()
+        volatile    uint8_t     sd_acc          = 0;        // The sigma-delta power accumulator
+        Modulation              mod             = MOD_SIGMA_DELTA;
+        volatile    uint16_t    adc_summ        = 0;        // The summ of the conversions of the burst
+        volatile    uint8_t     adc_cnt         = 0;        // The number of the conversions in the burst
+        const       uint8_t     adc_samples     = 16;       // The burst length, 4^n conversions give n more bits
+        const       uint8_t     adc_shift       = 2;        // Decimate the summ to 12 bits
+        volatile    bool        adc_tagged      = false;    // The burst started in the half-period the heater switched
+        uint16_t                sample_phase    = 2000;     // The ADC burst start after the AC sync edge, us
+        volatile    uint8_t     phase_cnt       = 0;        // The complete Timer0 rounds (256 ticks) to wait
+        const       uint16_t    sample_phase_max = 6000;    // The burst (1.7 ms) ends before the next sync of 60 Hz mains
+        const       uint16_t    switch_settle   = 1000;     // The triac switching transient, us
         const       uint32_t    relay_activate  = 1;        // The relay activation delay (loops of TIM1, 1 time per second)
 };
 
@@ -80,9 +207,11 @@ class HOTGUN : public HOTGUN_HW, public PID {
     public:
         typedef enum { POWER_OFF, POWER_ON, POWER_FIXED, POWER_COOLING } PowerMode;
         HOTGUN(uint8_t HG_sen_pin, uint8_t HG_pwr_pin, uint8_t HG_ac_relay_pin) :
-        HOTGUN_HW(HG_sen_pin, HG_pwr_pin, HG_ac_relay_pin), h_power(hot_gun_hist_length) { }
+        HOTGUN_HW(HG_sen_pin, HG_pwr_pin, HG_ac_relay_pin) { }
         void        init(void);
         bool        isOn(void)                              { return (mode == POWER_ON || mode == POWER_FIXED); }
+        PowerMode   powerMode(void)                         { return mode;                                  }
+        bool        isChill(void)                           { return chill;                                 }
         uint16_t    presetTemp(void)                        { return temp_set;                              }
         uint16_t    presetFan(void)                         { return fan_speed;                             }
         uint16_t    averageTemp(void)                       { return h_temp.read();                         }
@@ -92,6 +221,8 @@ class HOTGUN : public HOTGUN_HW, public PID {
         bool        isFanWorking(void)                      { return (fanSpeed() >= min_fan_speed);         }
         uint16_t    maxFanSpeed(void)                       { return max_fan_speed;                         }
         uint16_t    pwrDispersion(void)                     { return d_power.read();                        }
+        bool        isReady(void)                           { return approach.converged();                  }
+        uint16_t    readyTime(void)                         { return approach.timeLeft();                   }
         void        setTemp(uint16_t temp)                  { temp_set  = constrain(temp, 0, temp_max); 	}
         void        updateTemp(uint16_t value)              { h_temp.update(value);   						}
         void        setFan(uint16_t fan)                    { fan_speed = constrain(fan, min_fan_speed, max_fan_speed);   }
@@ -103,8 +234,14 @@ class HOTGUN : public HOTGUN_HW, public PID {
         void        fixPower(uint8_t Power);                // Set the specified power to the the hot gun
         uint8_t     presetFanPcnt(void);
         void        keepTemp(void);                         // Calculate Hot Air Gun power to keep the preset temperature
+        void        powerModel(const PWR_TABLE *table, const uint16_t temp[3])  { pwr_model.init(table, temp); ff_temp = 0;  }
+        void        learnedPower(PWR_TABLE &pwr)            { pwr_model.table(pwr);                         }
+        void        fanSlew(uint16_t s);                    // The fan speed change per power period
+        void        controlPeriod(uint8_t half_periods);    // The control period, the divisor of the power period
     private:
         void        shutdown(void);
+        void        warmStart(void);                        // Reset the PID, it starts from the model power
+        void        learnPower(uint16_t t);                 // Learn the steady-state power when the temperature is stable
         FastPWM_D9  hg_fan;
         PowerMode   mode                = POWER_OFF;
         uint8_t     fix_power           = 0;                // Fixed power value of the Hot Air Gun (or zero if off)
@@ -113,15 +250,21 @@ class HOTGUN : public HOTGUN_HW, public PID {
         uint16_t    fan_speed           = 0;                // Preset fan speed
         uint32_t    fan_off_time        = 0;                // Time when the fan should be powered off in cooling mode (ms)
         uint32_t	extra_cooling		= 0;				// Time when completely power off the fan
-        EMP_AVERAGE h_power;                                // Exponential average of applied power
-        EMP_AVERAGE d_power;                                // Exponential average of power dispersion
-        EMP_AVERAGE zero_temp;                              // Exponential average of minimum (zero) temperature
+        EMP_SHIFT<hot_gun_hist_shift>   h_power;            // Exponential average of applied power
+        EMP_SHIFT<8>                    d_power;            // Exponential average of power dispersion, 256 power periods
+        PWR_MODEL   pwr_model;                              // The steady-state power by the preset temperature and the fan speed
+        APPROACH    approach;                               // The time to reach the preset temperature
+        uint16_t    ff_temp             = 0;                // The preset temperature the feed-forward power was calculated for
+        uint16_t    ff_fan              = 0;                // The fan speed the feed-forward power was calculated for
+        uint8_t     stable_cnt          = 0;                // The number of power periods the temperature is stable
         const       uint8_t     max_fix_power   = 70;
         const       uint8_t     max_power       = 99;
         const       uint16_t    max_cool_fan    = 1700;
-        const       uint16_t    temp_gun_cold   = 20;       // The temperature of the cold Hot Air Gun
+        const       uint16_t    temp_gun_cold   = 80;       // The temperature of the cold Hot Air Gun
         const       uint32_t    fan_off_timeout = 5*60*1000;// The timeout to turn the fan off in cooling mode
-        const       uint8_t     ec              = 200;      // Exponential average coefficient (default value)
+        const       uint8_t     stable_temp     = 8;        // The temperature band to learn the steady-state power (internal units)
+        const       uint8_t     stable_periods  = 20;       // The time the temperature should be stable to learn the power (s)
+        uint16_t                fan_slew        = 400;      // The fan speed change per power period, see FastPWM_D9::ramp()
 };
 
 #endif
@@ -0,0 +1,60 @@
+#ifndef _CALIB_REF_H_
+#define _CALIB_REF_H_
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "vars.h"
+
+//------------------------------------------ The reference calibration conversion -----------------------------
+/* HOTGUN_CFG::tempHuman() and tempInternal() as they were before the segment tables (see config.h):
+ * map() of the calibration segment and the binary search of the internal temperature by tempHuman().
+ * The segments are of the ambient temperature and the reference points (calib_tip), the last one is extended.
+ * The tables must be bit-exact with tempHuman(); tempInternal() now returns the lowest internal temperature
+ * of the Celsius value, the binary search returned any of them.
+ */
+class CALIB_REF {
+    public:
+        CALIB_REF(const uint16_t tip[])                                     { for (uint8_t i = 0; i < calib_points; ++i) t_tip[i] = tip[i]; }
+        uint16_t tempHuman(uint16_t temp) {
+            if (temp <= ambient_temp)
+                return ambient_tempC;
+            if (temp < t_tip[0])
+                return map(temp, ambient_temp, t_tip[0], ambient_tempC, calib_tip[0]);
+            uint8_t i = 1;
+            while (i < calib_points-1 && temp > t_tip[i]) ++i;
+            return map(temp, t_tip[i-1], t_tip[i], calib_tip[i-1], calib_tip[i]);
+        }
+        uint16_t tempInternal(uint16_t t) {
+            t = constrain(t, temp_minC, temp_maxC);
+            uint16_t left   = 0;
+            uint16_t right  = 4095;
+            uint8_t  l      = calib_points-1;
+            uint16_t temp   = map(t, calib_tip[0], calib_tip[l], t_tip[0], t_tip[l]);
+            if (temp > (left+right)/ 2)
+                temp -= (right-left) / 4;
+            else
+                temp += (right-left) / 4;
+            for (uint8_t i = 0; i < 20; ++i) {
+                uint16_t tempH = tempHuman(temp);
+                if (tempH == t) return temp;
+                uint16_t new_temp;
+                if (tempH < t) {
+                    left = temp;
+                    new_temp = (left+right)/2;
+                    if (new_temp == temp) new_temp = temp + 1;
+                } else {
+                    right = temp;
+                    new_temp = (left+right)/2;
+                    if (new_temp == temp) new_temp = temp - 1;
+                }
+                temp = new_temp;
+            }
+            return temp;
+        }
+    private:
+        uint16_t    t_tip[max_calib_points];
+        const uint16_t ambient_temp     = 268;                              // See HOTGUN_CFG
+        const uint16_t ambient_tempC    = 25;
+};
+
+#endif
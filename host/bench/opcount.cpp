@@ -0,0 +1,112 @@
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include "opcount.h"
+
+bool OPCOUNT::count(FUNC f, void *ctx, uint32_t calls, OPCOUNT_STAT &stat) {
+    TOTAL empty, total;
+    if (calls == 0) return false;
+    if (!trace(f, ctx, 0, empty) || !trace(f, ctx, calls, total))          // The empty run measures the tracing overhead
+        return false;
+    stat.instructions   = double(total.instr     - empty.instr)     / calls;
+    stat.div32          = double(total.div32     - empty.div32)     / calls;
+    stat.div_short      = double(total.div_short - empty.div_short) / calls;
+    stat.mul            = double(total.mul       - empty.mul)       / calls;
+    stat.mul_long       = double(total.mul_long  - empty.mul_long)  / calls;
+    return true;
+}
+
+bool OPCOUNT::trace(FUNC f, void *ctx, uint32_t calls, TOTAL &total) {
+    memset(&total, 0, sizeof(total));
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {                                                         // The traced process
+        if (ptrace(PTRACE_TRACEME, 0, 0, 0) < 0) _exit(1);
+        raise(SIGSTOP);                                                     // Start counting
+        for (uint32_t i = 0; i < calls; ++i)
+            (*f)(ctx);
+        raise(SIGSTOP);                                                     // Stop counting
+        _exit(0);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) return false;
+    bool ok = false;
+    for (;;) {
+        struct user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, pid, 0, &regs) < 0) break;
+        union { long word[2]; uint8_t byte[16]; } code;
+        code.word[0] = ptrace(PTRACE_PEEKTEXT, pid, regs.rip, 0);
+        code.word[1] = ptrace(PTRACE_PEEKTEXT, pid, regs.rip + sizeof(long), 0);
+        decode(code.byte, total);
+        if (ptrace(PTRACE_SINGLESTEP, pid, 0, 0) < 0) break;
+        if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) break;
+        if (WSTOPSIG(status) == SIGSTOP) {                                  // The second raise(SIGSTOP) reached
+            ok = true;
+            break;
+        }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return ok;
+}
+
+void OPCOUNT::decode(const uint8_t *code, TOTAL &total) {
+    ++total.instr;
+    uint8_t i       = 0;
+    bool    op16    = false;
+    bool    rex_w   = false;
+    for (; i < 14; ++i) {                                                   // Legacy prefixes
+        uint8_t b = code[i];
+        if (b == 0x66) {
+            op16 = true;
+        } else if (b != 0x67 && b != 0xF0 && b != 0xF2 && b != 0xF3 && b != 0x2E &&
+                   b != 0x36 && b != 0x3E && b != 0x26 && b != 0x64 && b != 0x65) {
+            break;
+        }
+    }
+    if ((code[i] & 0xF0) == 0x40) {                                         // REX prefix
+        rex_w = code[i] & 0x08;
+        ++i;
+    }
+    uint8_t op  = code[i];
+    uint8_t reg = (code[i+1] >> 3) & 7;                                     // ModRM.reg selects the group 3 operation
+    if (op == 0xF7) {
+        if (reg == 6 || reg == 7) {
+            if (rex_w || !op16) ++total.div32; else ++total.div_short;
+        } else if (reg == 4 || reg == 5) {
+            ++total.mul;
+            if (rex_w) ++total.mul_long;
+        }
+    } else if (op == 0xF6) {
+        if (reg == 6 || reg == 7)       ++total.div_short;
+        else if (reg == 4 || reg == 5)  ++total.mul;
+    } else if (op == 0x69 || op == 0x6B || (op == 0x0F && code[i+1] == 0xAF)) {
+        ++total.mul;
+        if (rex_w) ++total.mul_long;
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double nsPerCall(OPCOUNT::FUNC f, void *ctx, double min_seconds) {
+    uint32_t calls = 1000;
+    for (;;) {
+        double start = now();
+        for (uint32_t i = 0; i < calls; ++i)
+            (*f)(ctx);
+        double elapsed = now() - start;
+        if (elapsed >= min_seconds || calls >= (1u << 30))
+            return elapsed * 1e9 / calls;
+        calls <<= 2;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef _OPCOUNT_H_
+#define _OPCOUNT_H_
+
+#include <stdint.h>
+
+//------------------------------------------ Executed operations counter --------------------------------------
+/* Runs the function in the forked process under ptrace() single-stepping and decodes every executed x86-64
+ * instruction. The integer divides and multiplies are counted separately: on the 8-bit AVR they are the
+ * library calls (__udivmodsi4 & co.) that dominate the cost of the firmware hot paths.
+ * Note, the firmware 'long' is 64-bit on the host, so 64-bit divides are counted as 32-bit ones and 64-bit multiplies
+ * are the 32x32 bit multiplies of the firmware (mul_long).
+ */
+struct OPCOUNT_STAT {
+    double      instructions;                                               // Executed instructions per call
+    double      div32;                                                      // 32 (and 64) bit integer divides per call
+    double      div_short;                                                  // 8 and 16 bit integer divides per call
+    double      mul;                                                        // Integer multiplies per call
+    double      mul_long;                                                   // Multiplies of 64-bit operands (firmware 'long') per call
+};
+
+class OPCOUNT {
+    public:
+        typedef void    (*FUNC)(void *ctx);
+        static bool     count(FUNC f, void *ctx, uint32_t calls, OPCOUNT_STAT &stat);
+    private:
+        struct TOTAL    { uint64_t instr, div32, div_short, mul, mul_long; };
+        static bool     trace(FUNC f, void *ctx, uint32_t calls, TOTAL &total);
+        static void     decode(const uint8_t *code, TOTAL &total);
+};
+
+//------------------------------------------ Wall clock time of the function call ----------------------------
+double  nsPerCall(OPCOUNT::FUNC f, void *ctx, double min_seconds = 0.05);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _PID_REF_H_
+#define _PID_REF_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------------ The reference PID implementation ---------------------------------
+/* PID::reqPower() as it was before the fixed-point kernel (see pid.h), kept to check the kernel is bit-exact.
+ * The thresholds and the denominator are of the 12-bit temperature (see HOTGUN_HW).
+ * The firmware 'long' is 32-bit, here it is 64-bit: the reference never overflows, so overflow() tells
+ * whether the firmware would have exceeded the 32-bit range: the kernel saturates there and differs on purpose.
+ * The rate r is of the faster loop (see PID::controlRate()): Kp and Kd are multiplied by r and r*r, the power
+ * is divided by r*2^13 with rounding. There overflow() also tells whether the kernel saturates the temperature
+ * differences multiplied by r, and the negative power is zero: the caller clamps it anyway.
+ */
+class PID_REF {
+    public:
+        PID_REF(long kp = 50, long ki = 16, long kd = 50, long r = 1)       { Kp = kp; Ki = ki; Kd = kd; rate = r; }
+        void resetPID(int temp = -1) {
+            overflowed = false;
+            temp_h0 = 0;
+            power  = 0;
+            i_summ = 0;
+            pid_iterate = false;
+            if ((temp > 0) && (temp < 4096))
+                temp_h1 = temp;
+            else
+                temp_h1 = 0;
+        }
+        long reqPower(int temp_set, int temp_curr) {
+            if (temp_h0 == 0) {
+                if ((temp_set - temp_curr) < 120) {
+                    if (!pid_iterate) {
+                        pid_iterate = true;
+                        power = 0;
+                        i_summ = 0;
+                    }
+                }
+                i_summ += temp_set - temp_curr;
+                power = Kp*rate*(temp_set - temp_curr) + Ki*i_summ;
+                overflowed |= !fits(Ki*i_summ);
+                if (rate > 1) overflowed |= labs(Kp*(temp_set - temp_curr)) > (INT32_MAX >> 8);
+            } else {
+                long kp = Kp * rate * (temp_h1 - temp_curr);
+                long ki = Ki * (temp_set - temp_curr);
+                long kd = Kd * rate * rate * (temp_h0 + temp_curr - 2*temp_h1);
+                overflowed |= labs(rate * (temp_h1 - temp_curr)) > 32767;
+                overflowed |= labs(rate * rate * (temp_h0 + temp_curr - 2*temp_h1)) > 32767;
+                long delta_p = kp + ki + kd;
+                power += delta_p;
+            }
+            if (pid_iterate) temp_h0 = temp_h1;
+            temp_h1 = temp_curr;
+            overflowed |= !fits(power + (rate << (denominator_p-1)));
+            long pwr = power + (rate << (denominator_p-1));
+            if (rate <= 1)
+                return pwr >> denominator_p;
+            if (pwr < 0) return 0;
+            pwr /= rate << denominator_p;
+            return (pwr > 32767 / rate)?32767 / rate:pwr;
+        }
+        bool overflow(void) const                                           { return overflowed; }
+    private:
+        static bool fits(long v)                                            { return v >= INT32_MIN && v <= INT32_MAX; }
+        bool    overflowed  = false;
+        int     temp_h0     = 0;
+        int     temp_h1     = 0;
+        bool    pid_iterate = false;
+        long    i_summ      = 0;
+        long    power       = 0;
+        long    Kp, Ki, Kd;
+        long    rate;
+        const uint8_t denominator_p = 13;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include "preempt.h"
+
+PREEMPT::FUNC   PREEMPT::isr        = 0;
+void*           PREEMPT::isr_ctx    = 0;
+volatile int*   PREEMPT::in_isr     = 0;
+
+void PREEMPT::handler(int sig) {
+    (void)sig;
+    *in_isr = 1;
+    if (isr) (*isr)(isr_ctx);
+    raise(SIGUSR2);                                                         // Resume stepping, the tracer drops the signal
+    *in_isr = 0;
+}
+
+bool PREEMPT::run(FUNC reader, FUNC writer, void *ctx, uint32_t calls, uint16_t rate, uint32_t seed) {
+    if (rate == 0) return false;
+    in_isr = (volatile int *)shared(sizeof(int));
+    if (!in_isr) return false;
+    pid_t pid = fork();
+    if (pid < 0) {
+        release((void *)in_isr, sizeof(int));
+        return false;
+    }
+    if (pid == 0) {                                                         // The traced process
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler   = handler;                                          // SIGUSR1 is blocked while the handler runs
+        isr             = writer;
+        isr_ctx         = ctx;
+        if (sigaction(SIGUSR1, &sa, 0) < 0) _exit(1);
+        if (ptrace(PTRACE_TRACEME, 0, 0, 0) < 0) _exit(1);
+        raise(SIGSTOP);                                                     // Start stepping
+        for (uint32_t i = 0; i < calls; ++i)
+            (*reader)(ctx);
+        raise(SIGSTOP);                                                     // Stop stepping
+        _exit(0);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) return false;
+    uint32_t rnd = seed?seed:1;
+    int      sig = 0;
+    bool     ok  = false;
+    for (;;) {
+        // Deliver the interrupt before the next instruction and run the handler at full speed
+        if (ptrace(sig?PTRACE_CONT:PTRACE_SINGLESTEP, pid, 0, sig) < 0) break;
+        if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) break;
+        if (WSTOPSIG(status) == SIGSTOP) {                                  // The second raise(SIGSTOP) reached
+            ok = true;
+            break;
+        }
+        sig = 0;
+        if (*in_isr) continue;                                              // Only the reader instructions are interrupted
+        rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;                // xorshift32
+        if (rnd % rate == 0) sig = SIGUSR1;
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    release((void *)in_isr, sizeof(int));
+    return ok;
+}
+
+void* PREEMPT::shared(size_t size) {
+    void *mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return (mem == MAP_FAILED)?0:mem;                                       // Anonymous mapping is zeroed
+}
+
+void PREEMPT::release(void *mem, size_t size) {
+    if (mem) munmap(mem, size);
+}
@@ -0,0 +1,28 @@
+#ifndef _PREEMPT_H_
+#define _PREEMPT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//------------------------------------------ Interrupt preemption emulator ------------------------------------
+/* Runs the reader function in the forked process under ptrace() single-stepping (as OPCOUNT does) and injects
+ * the "interrupt" between the instructions: the SIGUSR1 handler of the child calls the writer function.
+ * The interrupt points are pseudo-random, on average every 'rate' instructions of the reader, so every
+ * instruction boundary of the reader is hit by the long enough run. The writer runs to completion before
+ * the reader continues and is not interrupted itself, as the AVR interrupt handler is; the handler is not stepped.
+ * The context is changed by the child: allocate it by shared() to see the results in the parent process.
+ */
+class PREEMPT {
+    public:
+        typedef void    (*FUNC)(void *ctx);
+        static bool     run(FUNC reader, FUNC writer, void *ctx, uint32_t calls, uint16_t rate, uint32_t seed);
+        static void*    shared(size_t size);                                // Zeroed memory shared with the child process
+        static void     release(void *mem, size_t size);
+    private:
+        static void     handler(int sig);
+        static FUNC     isr;
+        static void*    isr_ctx;
+        static volatile int* in_isr;                                        // Shared: the child is in the handler, do not inject
+};
+
+#endif
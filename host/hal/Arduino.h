@@ -0,0 +1,85 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+/*
+ * The host replacement of the Arduino core used to build the firmware on Linux.
+ * Only the part of the Arduino API the firmware uses is implemented here. All the hardware is simulated
+ * by the virtual board (see vboard.h) that is owned by the current thread.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "Print.h"
+#include "vboard.h"
+
+typedef uint8_t     byte;
+typedef bool        boolean;
+typedef uint16_t    word;
+
+#define HIGH            0x1
+#define LOW             0x0
+
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define DEFAULT         1
+#define EXTERNAL        0
+#define INTERNAL        3
+
+#define PI              3.1415926535897932384626433832795
+
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+
+#define constrain(amt,low,high)         ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define digitalPinToInterrupt(p)        ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+#define interrupts()                    sei()
+#define noInterrupts()                  cli()
+
+long        map(long x, long in_min, long in_max, long out_min, long out_max);
+
+inline uint32_t millis(void)                                                { return vboard.millis();                   }
+inline uint32_t micros(void)                                                { return vboard.micros();                   }
+inline void     delay(unsigned long ms)                                     { vboard.advance(ms * 1000);                }
+inline void     delayMicroseconds(unsigned int us)                          { vboard.advance(us);                       }
+inline void     pinMode(uint8_t pin, uint8_t mode)                          { vboard.pinMode(pin, mode);                }
+inline void     digitalWrite(uint8_t pin, uint8_t val)                      { vboard.digitalWrite(pin, val);            }
+inline int      digitalRead(uint8_t pin)                                    { return vboard.digitalRead(pin);           }
+inline int      analogRead(uint8_t pin)                                     { return vboard.analogRead(pin);            }
+inline void     analogReference(uint8_t mode)                               { vboard.analogReference(mode);             }
+inline void     attachInterrupt(uint8_t irq, void (*isr)(void), int mode)   { vboard.attachInterrupt(irq, isr, mode);   }
+inline void     detachInterrupt(uint8_t irq)                                { vboard.detachInterrupt(irq);              }
+inline void     tone(uint8_t pin, unsigned int freq, unsigned long dur = 0) { vboard.tone(pin, freq, dur);              }
+inline void     noTone(uint8_t pin)                                         { (void)pin;                                }
+
+//------------------------------------------ class HardwareSerial ---------------------------------------------
+class HardwareSerial : public Print {
+    public:
+        void            begin(unsigned long baud)                           { (void)baud; }
+        void            end(void)                                           { }
+        void            flush(void)                                         { }
+        int             available(void)                                     { return vboard.serialAvailable(); }
+        int             read(void)                                          { return vboard.serialRead(); }
+        virtual size_t  write(uint8_t c)                                    { vboard.serialWrite((const char *)&c, 1); return 1; }
+        virtual size_t  write(const uint8_t *buffer, size_t size)           { vboard.serialWrite((const char *)buffer, size); return size; }
+        using Print::write;
+        operator bool(void)                                                 { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+#include "vboard.h"
+
+//------------------------------------------ class EEPROM (host replacement, see VBOARD::eepromFile()) -------
+class EEPROMClass {
+    public:
+        uint8_t         read(int idx)                                       { return vboard.eepromRead(idx);    }
+        void            write(int idx, uint8_t val)                         { vboard.eepromWrite(idx, val);     }
+        void            update(int idx, uint8_t val)                        { if (read(idx) != val) write(idx, val); }
+        uint16_t        length(void)                                        { return vb_eeprom_size;            }
+};
+
+inline EEPROMClass EEPROM;                                                  // One instance for all the modules
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef LiquidCrystal_I2C_h
+#define LiquidCrystal_I2C_h
+
+#include <stdint.h>
+#include "Print.h"
+
+//------------------------------------------ class LiquidCrystal_I2C (host replacement) ----------------------
+/* Writes the characters to the text buffer of the virtual board, see VBOARD::lcdLine() */
+class LiquidCrystal_I2C : public Print {
+    public:
+        LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows)         { (void)addr; this->cols = cols; this->rows = rows; col = row = 0; }
+        void            begin(void)                                         { clear(); }
+        void            init(void)                                          { clear(); }
+        void            clear(void);
+        void            home(void)                                          { col = row = 0; }
+        void            setCursor(uint8_t c, uint8_t r)                     { col = c; row = r; }
+        void            createChar(uint8_t location, uint8_t charmap[])     { (void)location; (void)charmap; }
+        void            backlight(void)                                     { }
+        void            noBacklight(void)                                   { }
+        virtual size_t  write(uint8_t c);
+        using Print::write;
+    private:
+        uint8_t         cols, rows;
+        uint8_t         col, row;                                           // The cursor position
+};
+
+#endif
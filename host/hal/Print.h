@@ -0,0 +1,41 @@
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+//------------------------------------------ class Print (host replacement of the Arduino core class) --------
+class Print {
+    public:
+        virtual         ~Print(void)                                        { }
+        virtual size_t  write(uint8_t c)                                    = 0;
+        virtual size_t  write(const uint8_t *buffer, size_t size);
+        size_t          write(const char *str)                              { return str?write((const uint8_t *)str, strlen(str)):0; }
+        size_t          print(const __FlashStringHelper *str)               { return write((const char *)str); }
+        size_t          print(const char str[])                             { return write(str); }
+        size_t          print(char c)                                       { return write(uint8_t(c)); }
+        size_t          print(unsigned char n, int base = DEC)              { return printNumber(n, base, false); }
+        size_t          print(int n, int base = DEC)                        { return printNumber(n, base, true);  }
+        size_t          print(unsigned int n, int base = DEC)               { return printNumber(n, base, false); }
+        size_t          print(long n, int base = DEC)                       { return printNumber(n, base, true);  }
+        size_t          print(unsigned long n, int base = DEC)              { return printNumber(n, base, false); }
+        size_t          print(double n, int digits = 2);
+        size_t          println(void)                                       { return write("\r\n"); }
+        template <typename T>
+        size_t          println(T v)                                        { size_t n = print(v); return n + println(); }
+        template <typename T>
+        size_t          println(T v, int base)                              { size_t n = print(v, base); return n + println(); }
+    private:
+        size_t          printNumber(unsigned long n, int base, bool is_signed);
+};
+
+#endif
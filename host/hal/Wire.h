@@ -0,0 +1,10 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+// The I2C bus is not simulated: the LCD replacement (LiquidCrystal_I2C.h) writes to the virtual board directly
+class TwoWire {
+    public:
+        void            begin(void)                                         { }
+};
+
+#endif
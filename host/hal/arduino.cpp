@@ -0,0 +1,48 @@
+#include "Arduino.h"
+#include "LiquidCrystal_I2C.h"
+
+HardwareSerial Serial;
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+//------------------------------------------ class Print ------------------------------------------------------
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::print(double n, int digits) {
+    char buff[32];
+    snprintf(buff, sizeof(buff), "%.*f", digits, n);
+    return write(buff);
+}
+
+size_t Print::printNumber(unsigned long n, int base, bool is_signed) {
+    char buff[8 * sizeof(long) + 2];
+    char *str = &buff[sizeof(buff) - 1];
+    *str = '\0';
+    bool negative = is_signed && (long)n < 0;
+    if (negative) n = -(long)n;
+    if (base < 2) base = 10;
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    if (negative) *--str = '-';
+    return write(str);
+}
+
+//------------------------------------------ class LiquidCrystal_I2C ------------------------------------------
+void LiquidCrystal_I2C::clear(void) {
+    vboard.lcdClear();
+    col = row = 0;
+}
+
+size_t LiquidCrystal_I2C::write(uint8_t c) {
+    vboard.lcdPut(col++, row, (char)c);
+    return 1;
+}
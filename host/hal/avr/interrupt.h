@@ -0,0 +1,16 @@
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#include "../vboard.h"
+
+inline void     sei(void)                                                   { vboard.enableInterrupts(true);    }
+inline void     cli(void)                                                   { vboard.enableInterrupts(false);   }
+
+// The handler of the peripheral interrupt is registered in the vector table of the virtual board
+#define ISR(vector)     static void vector##_handler(void);                                 \
+                        static VB_VECTOR vector##_register(vector, vector##_handler);       \
+                        static void vector##_handler(void)
+#define ADC_vect        VB_ADC_VECT
+#define TIMER0_COMPA_vect   VB_TIMER0_COMPA_VECT
+
+#endif
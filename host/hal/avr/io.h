@@ -0,0 +1,61 @@
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+/*
+ * The ATmega328 registers the firmware accesses directly.
+ * The registers are the fields of the virtual board of the current thread (see vboard.h)
+ */
+#include "../vboard.h"
+
+#define _BV(bit)        (1 << (bit))
+
+// Timer/Counter1, used by FastPWM_D9 to drive the Hot Air Gun fan
+#define TCCR1A          (vboard.reg.tccr1a)
+#define TCCR1B          (vboard.reg.tccr1b)
+#define TCNT1           (vboard.reg.tcnt1)
+#define OCR1A           (vboard.reg.ocr1a)
+#define ICR1            (vboard.reg.icr1)
+
+#define WGM10           0
+#define WGM11           1
+#define COM1B0          4
+#define COM1B1          5
+#define COM1A0          6
+#define COM1A1          7
+#define CS10            0
+#define CS11            1
+#define CS12            2
+#define WGM12           3
+#define WGM13           4
+
+// Timer/Counter0 counts the Arduino core time, the compare match A interrupt is free
+#define TCCR0A          (vboard.reg.tccr0a)
+#define TCNT0           (vboard.tcnt0())
+#define OCR0A           (vboard.reg.ocr0a)
+#define TIMSK0          (vboard.reg.timsk0)
+#define TIFR0           (vboard.reg.tifr0)
+
+#define WGM00           0
+#define WGM01           1
+#define OCIE0A          1
+#define OCF0A           1
+
+// The ADC, converts the temperature sensor in the free running mode with the conversion complete interrupt
+#define ADMUX           (vboard.reg.admux)
+#define ADCSRA          (vboard.reg.adcsra)
+#define ADCSRB          (vboard.reg.adcsrb)
+#define ADC             (vboard.reg.adc)
+
+#define REFS1           7
+#define REFS0           6
+#define ADLAR           5
+#define ADEN            7
+#define ADSC            6
+#define ADATE           5
+#define ADIF            4
+#define ADIE            3
+#define ADPS2           2
+#define ADPS1           1
+#define ADPS0           0
+
+#endif
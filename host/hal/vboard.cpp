@@ -0,0 +1,314 @@
+#include <string.h>
+#include "Arduino.h"
+#include "vboard.h"
+
+thread_local VBOARD vboard;
+void (*vb_vector[vb_vectors])(void);
+
+//------------------------------------------ Virtual Arduino Nano board ---------------------------------------
+VBOARD::~VBOARD(void) {
+    if (eeprom_file) fclose(eeprom_file);
+}
+
+void VBOARD::reset(void) {
+    now_us          = 0;
+    half_period     = 0;
+    next_sync       = 0;
+    half_cycle_cb   = 0;
+    half_cycle_ctx  = 0;
+    aref            = DEFAULT;
+    adc_cb          = 0;
+    adc_ctx         = 0;
+    for (uint8_t i = 0; i < vb_vectors; ++i) {
+        vect_hook[i]    = 0;
+        vect_ctx[i]     = 0;
+    }
+    vect_pending    = 0;
+    adc_done        = 0;
+    irq_enabled     = true;
+    irq_pending     = 0;
+    in_isr          = false;
+    serial_out      = 0;
+    rx_head         = 0;
+    rx_len          = 0;
+    beep_count      = 0;
+    for (uint8_t i = 0; i < vb_pins; ++i) {
+        mode[i]         = INPUT;
+        out_level[i]    = LOW;
+        in_level[i]     = HIGH;                                             // Not connected input pin, pulled up
+    }
+    for (uint8_t i = 0; i < vb_pins - vb_analog_first; ++i)
+        analog[i] = 0;
+    for (uint8_t i = 0; i < vb_irqs; ++i) {
+        isr[i]      = 0;
+        isr_mode[i] = 0;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.tccr0a      = _BV(WGM01) | _BV(WGM00);                              // The fast PWM mode set by the Arduino core init()
+    ocr0a           = 0;
+    lcdClear();
+}
+
+void VBOARD::advance(uint32_t us) {
+    uint64_t target = now_us + us;
+    for (;;) {
+        adcStart();
+        bool sync = half_period && next_sync <= target;
+        uint64_t limit   = sync?next_sync:target + 1;                       // The events before the sync pulse
+        uint64_t compare = compareTime();
+        uint64_t bottom  = bottomTime();
+        bool     adc     = adc_done && adc_done < limit;
+        if (compare && compare < limit && (!adc || compare < adc_done) && (!bottom || compare <= bottom)) {
+            now_us = compare;
+            raise(VB_TIMER0_COMPA_VECT);
+            continue;
+        }
+        if (bottom && bottom < limit && (!adc || bottom <= adc_done)) {
+            now_us = bottom;
+            ocr0a  = reg.ocr0a;
+            continue;
+        }
+        if (adc) {
+            now_us = adc_done;
+            adcComplete();
+            continue;
+        }
+        if (!sync) break;
+        now_us = next_sync;
+        next_sync += half_period;
+        if (half_cycle_cb) (*half_cycle_cb)(half_cycle_ctx);
+        setInput(2, HIGH);                                                  // The AC sync pulse: short positive pulse on D2
+        setInput(2, LOW);
+    }
+    now_us = target;
+}
+
+void VBOARD::adcStart(void) {
+    const uint8_t start = _BV(ADEN) | _BV(ADSC);
+    if (adc_done == 0 && (reg.adcsra & start) == start)
+        adc_done = now_us + vb_adc_conv_us;
+}
+
+void VBOARD::adcComplete(void) {
+    adc_done = 0;
+    if (aref == EXTERNAL && (reg.admux & (_BV(REFS1) | _BV(REFS0)))) {     // The internal reference is shorted to the driven AREF pin
+        fprintf(stderr, "vboard: ADMUX selects the internal ADC reference while AREF is driven externally\n");
+        abort();
+    }
+    reg.adc  = analogRead(vb_analog_first + (reg.admux & 0x07));
+    if (reg.adcsra & _BV(ADATE))                                            // The free running mode
+        adc_done = now_us + vb_adc_conv_us;
+    else
+        reg.adcsra &= ~_BV(ADSC);                                           // ADSC is cleared when the conversion is complete
+    if (reg.adcsra & _BV(ADIE))
+        raise(VB_ADC_VECT);
+}
+
+// The counter reaches OCR0A at the beginning of the tick, every 256 ticks
+uint64_t VBOARD::compareTime(void) {
+    if (!(reg.timsk0 & _BV(OCIE0A))) return 0;
+    uint64_t tick = now_us / vb_timer0_tick_us + 1;
+    if (!ocr0aBuffered()) {
+        tick += uint8_t(reg.ocr0a - uint8_t(tick));
+        return tick * vb_timer0_tick_us;
+    }
+    uint64_t bottom = (tick + 0xFF) & ~uint64_t(0xFF);                      // The first BOTTOM from the tick
+    uint64_t match  = tick + uint8_t(ocr0a - uint8_t(tick));
+    if (match >= bottom)                                                    // The written value is loaded at BOTTOM
+        match = bottom + reg.ocr0a;
+    return match * vb_timer0_tick_us;
+}
+
+uint64_t VBOARD::bottomTime(void) {
+    if (!ocr0aBuffered() || ocr0a == reg.ocr0a) return 0;
+    const uint64_t round_us = 256 * vb_timer0_tick_us;
+    return (now_us + round_us - 1) / round_us * round_us;
+}
+
+void VBOARD::raise(uint8_t vect) {
+    if (irq_enabled && !in_isr)
+        callVector(vect);
+    else
+        vect_pending |= 1 << vect;
+}
+
+void VBOARD::callVector(uint8_t vect) {
+    in_isr      = true;
+    irq_enabled = false;
+    if (vect_hook[vect])
+        (*vect_hook[vect])(vect_ctx[vect]);
+    else if (vb_vector[vect])
+        (*vb_vector[vect])();
+    irq_enabled = true;
+    in_isr      = false;
+    enableInterrupts(true);
+}
+
+void VBOARD::setMains(uint16_t half_period_us) {
+    half_period = half_period_us;
+    next_sync   = now_us + half_period;
+}
+
+void VBOARD::pinMode(uint8_t pin, uint8_t m) {
+    if (pin >= vb_pins) return;
+    mode[pin] = m;
+}
+
+void VBOARD::digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= vb_pins) return;
+    out_level[pin] = value?HIGH:LOW;
+}
+
+int VBOARD::digitalRead(uint8_t pin) {
+    if (pin >= vb_pins) return LOW;
+    if (mode[pin] == OUTPUT) return out_level[pin];
+    return in_level[pin];
+}
+
+void VBOARD::setInput(uint8_t pin, uint8_t level) {
+    if (pin >= vb_pins) return;
+    uint8_t old = in_level[pin];
+    in_level[pin] = level?HIGH:LOW;
+    if (pin == 2 || pin == 3)
+        edge(pin - 2, old, in_level[pin]);
+}
+
+uint16_t VBOARD::analogRead(uint8_t pin) {
+    if (pin < vb_analog_first) pin += vb_analog_first;                      // analogRead(0) is the same as analogRead(A0)
+    if (pin >= vb_pins) return 0;
+    if (adc_cb) return (*adc_cb)(adc_ctx, pin);
+    return analog[pin - vb_analog_first];
+}
+
+void VBOARD::setAnalog(uint8_t pin, uint16_t value) {
+    if (pin < vb_analog_first) pin += vb_analog_first;
+    if (pin >= vb_pins) return;
+    if (value > 1023) value = 1023;                                         // The ADC is 10-bit
+    analog[pin - vb_analog_first] = value;
+}
+
+void VBOARD::attachInterrupt(uint8_t irq, void (*handler)(void), int m) {
+    if (irq >= vb_irqs) return;
+    isr[irq]        = handler;
+    isr_mode[irq]   = m;
+}
+
+void VBOARD::detachInterrupt(uint8_t irq) {
+    if (irq >= vb_irqs) return;
+    isr[irq] = 0;
+}
+
+void VBOARD::enableInterrupts(bool on) {
+    irq_enabled = on;
+    if (!on || in_isr) return;
+    for (uint8_t i = 0; i < vb_irqs; ++i) {                                 // Serve the interrupts raised while they were disabled
+        if (irq_pending & (1 << i)) {
+            irq_pending &= ~(1 << i);
+            callISR(i);
+        }
+    }
+    for (uint8_t i = 0; i < vb_vectors; ++i) {
+        if (vect_pending & (1 << i)) {
+            vect_pending &= ~(1 << i);
+            callVector(i);
+        }
+    }
+}
+
+void VBOARD::edge(uint8_t irq, uint8_t old_level, uint8_t new_level) {
+    if (!isr[irq] || old_level == new_level) return;
+    bool fire = false;
+    switch (isr_mode[irq]) {
+        case CHANGE:
+            fire = true;
+            break;
+        case RISING:
+            fire = (new_level == HIGH);
+            break;
+        case FALLING:
+            fire = (new_level == LOW);
+            break;
+        default:
+            break;
+    }
+    if (!fire) return;
+    if (irq_enabled && !in_isr)
+        callISR(irq);
+    else
+        irq_pending |= 1 << irq;
+}
+
+void VBOARD::callISR(uint8_t irq) {
+    in_isr      = true;
+    irq_enabled = false;                                                    // The AVR disables interrupts while ISR is running
+    (*isr[irq])();
+    irq_enabled = true;
+    in_isr      = false;
+    enableInterrupts(true);
+}
+
+void VBOARD::eepromWrite(uint16_t addr, uint8_t value) {
+    if (addr >= vb_eeprom_size) return;
+    eeprom[addr] = value;
+    if (eeprom_file) {
+        fseek(eeprom_file, addr, SEEK_SET);
+        fputc(value, eeprom_file);
+        fflush(eeprom_file);
+    }
+}
+
+bool VBOARD::eepromFile(const char *path) {
+    if (eeprom_file) fclose(eeprom_file);
+    eepromErase();
+    eeprom_file = fopen(path, "r+b");
+    if (eeprom_file) {
+        size_t n = fread(eeprom, 1, vb_eeprom_size, eeprom_file);
+        (void)n;                                                            // The short file is padded by erased bytes
+    } else {
+        eeprom_file = fopen(path, "w+b");
+        if (!eeprom_file) return false;
+    }
+    fseek(eeprom_file, 0, SEEK_SET);
+    fwrite(eeprom, 1, vb_eeprom_size, eeprom_file);
+    fflush(eeprom_file);
+    return true;
+}
+
+void VBOARD::eepromErase(void) {
+    memset(eeprom, 0xff, vb_eeprom_size);
+}
+
+void VBOARD::serialWrite(const char *data, size_t len) {
+    if (serial_out) fwrite(data, 1, len, serial_out);
+}
+
+void VBOARD::serialFeed(const char *data, size_t len) {
+    for (size_t i = 0; i < len && rx_len < vb_serial_rx_size; ++i, ++rx_len)
+        rx[(rx_head + rx_len) % vb_serial_rx_size] = data[i];
+}
+
+int VBOARD::serialRead(void) {
+    if (rx_len == 0) return -1;
+    int c = uint8_t(rx[rx_head]);
+    rx_head = (rx_head + 1) % vb_serial_rx_size;
+    --rx_len;
+    return c;
+}
+
+void VBOARD::tone(uint8_t pin, uint16_t freq, uint32_t duration) {
+    (void)pin; (void)freq; (void)duration;
+    ++beep_count;
+}
+
+void VBOARD::lcdClear(void) {
+    for (uint8_t r = 0; r < vb_lcd_rows; ++r) {
+        memset(lcd[r], ' ', vb_lcd_cols);
+        lcd[r][vb_lcd_cols] = '\0';
+    }
+}
+
+void VBOARD::lcdPut(uint8_t col, uint8_t row, char c) {
+    if (col >= vb_lcd_cols || row >= vb_lcd_rows) return;
+    if (c >= 0 && c < ' ') c = "?o*^"[c & 3];                               // Custom symbols: degree, fan and power signs
+    lcd[row][col] = c;
+}
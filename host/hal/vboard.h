@@ -0,0 +1,143 @@
+#ifndef _VBOARD_H_
+#define _VBOARD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+//------------------------------------------ Virtual Arduino Nano board ---------------------------------------
+/* The host replacement of the ATmega328 hardware used by the firmware.
+ * Every thread owns its own board instance (see vboard below), so independent simulations can run in parallel.
+ * The time is virtual: it goes forward only when advance() is called or the firmware calls delay().
+ * While the time goes forward, the board generates the AC synchronization pulses on D2 and calls
+ * the interrupt handlers attached by the firmware. The ADC converts when the firmware sets ADSC in ADCSRA,
+ * in the free running mode (ADATE) the next conversion starts at once; the conversion complete interrupt
+ * calls the ADC_vect handler of the firmware or the one set by vectorHook().
+ * Timer0 counts by 4 us (the Arduino core prescaler of 64), TCNT0 is derived from the time. When OCIE0A is set
+ * in TIMSK0, the compare match interrupt is called every time the counter reaches OCR0A. The Arduino core starts
+ * Timer0 in the fast PWM mode, where OCR0A is double-buffered: the value written is loaded at BOTTOM (TCNT0 = 0),
+ * until then the counter is compared with the old one. In the normal and CTC modes OCR0A is written at once.
+ */
+const uint8_t   vb_pins             = 20;                                   // D0-D13, A0-A5
+const uint8_t   vb_analog_first     = 14;                                   // A0 pin number
+const uint8_t   vb_irqs             = 2;                                    // INT0 (D2) and INT1 (D3)
+const uint16_t  vb_eeprom_size      = 1024;                                 // ATmega328 EEPROM size
+const uint16_t  vb_adc_conv_us      = 104;                                  // The ADC conversion time: 13 ADC clocks, 16 MHz / 128
+const uint8_t   vb_timer0_tick_us   = 4;                                    // Timer0 clock: 16 MHz / 64
+const uint8_t   vb_lcd_rows         = 2;
+const uint8_t   vb_lcd_cols         = 16;
+const uint8_t   vb_serial_rx_size   = 64;                                   // The Arduino core receive buffer, the extra bytes are lost
+
+struct VB_REGS {                                                            // The MCU registers the firmware writes directly
+    uint8_t     tccr1a, tccr1b;
+    uint16_t    tcnt1, ocr1a, icr1;
+    uint8_t     admux, adcsra, adcsrb;
+    uint16_t    adc;
+    uint8_t     tccr0a, ocr0a, timsk0, tifr0;
+};
+
+// The interrupt vectors of the MCU peripherals, the handlers are defined by the firmware by ISR() (see avr/interrupt.h)
+typedef enum { VB_ADC_VECT, VB_TIMER0_COMPA_VECT, vb_vectors } VB_VECTOR_NUM;
+extern void (*vb_vector[vb_vectors])(void);
+struct VB_VECTOR {
+    VB_VECTOR(uint8_t n, void (*handler)(void))                             { vb_vector[n] = handler; }
+};
+
+class VBOARD {
+    public:
+        typedef uint16_t    (*ADC_CB)(void *ctx, uint8_t pin);              // Returns the ADC reading of the analog pin
+        typedef void        (*HOOK_CB)(void *ctx);
+        VBOARD(void)                                                        { eeprom_file = 0; eepromErase(); reset(); }
+        ~VBOARD(void);
+        void        reset(void);                                            // Power-on state: time 0, pins floating, EEPROM kept
+        // Virtual clock
+        uint32_t    millis(void)                                            { return uint32_t(now_us / 1000); }
+        uint32_t    micros(void)                                            { return uint32_t(now_us); }
+        uint64_t    now(void)                                               { return now_us; }
+        void        advance(uint32_t us);                                   // Move the time forward, generate AC sync pulses
+        void        setMains(uint16_t half_period_us);                      // The AC half-period; 0 - no AC voltage
+        void        onHalfCycle(HOOK_CB cb, void *ctx)                      { half_cycle_cb = cb; half_cycle_ctx = ctx; }
+        // GPIO
+        void        pinMode(uint8_t pin, uint8_t mode);
+        void        digitalWrite(uint8_t pin, uint8_t value);
+        int         digitalRead(uint8_t pin);
+        uint8_t     output(uint8_t pin)                                     { return (pin < vb_pins)?out_level[pin]:0; }
+        void        setInput(uint8_t pin, uint8_t level);                   // Drive the input pin from outside, can trigger the interrupt
+        // ADC
+        uint16_t    analogRead(uint8_t pin);
+        void        setAnalog(uint8_t pin, uint16_t value);
+        void        analogReference(uint8_t mode)                           { aref = mode; }
+        void        adcSource(ADC_CB cb, void *ctx)                         { adc_cb = cb; adc_ctx = ctx; }
+        // Timer0
+        uint8_t     tcnt0(void)                                             { return uint8_t(now_us / vb_timer0_tick_us); }
+        // The peripheral interrupt handler instead of the ISR() of the firmware, zero - the ISR() one
+        void        vectorHook(uint8_t vect, HOOK_CB cb, void *ctx)         { if (vect < vb_vectors) { vect_hook[vect] = cb; vect_ctx[vect] = ctx; } }
+        // External interrupts
+        void        attachInterrupt(uint8_t irq, void (*isr)(void), int mode);
+        void        detachInterrupt(uint8_t irq);
+        void        enableInterrupts(bool on);
+        bool        interruptsEnabled(void)                                 { return irq_enabled; }
+        // EEPROM
+        uint8_t     eepromRead(uint16_t addr)                               { return (addr < vb_eeprom_size)?eeprom[addr]:0xff; }
+        void        eepromWrite(uint16_t addr, uint8_t value);
+        bool        eepromFile(const char *path);                           // Load the EEPROM content from the file and write it back on every update
+        void        eepromErase(void);
+        // Serial port
+        void        serialOut(FILE *f)                                      { serial_out = f; }
+        void        serialWrite(const char *data, size_t len);
+        void        serialFeed(const char *data, size_t len);               // The bytes received by the board
+        int         serialAvailable(void)                                   { return rx_len; }
+        int         serialRead(void);                                       // -1 if nothing received
+        // Buzzer
+        void        tone(uint8_t pin, uint16_t freq, uint32_t duration);
+        uint32_t    beeps(void)                                             { return beep_count; }
+        // LCD, written by the LiquidCrystal_I2C replacement
+        void        lcdClear(void);
+        void        lcdPut(uint8_t col, uint8_t row, char c);
+        const char* lcdLine(uint8_t row)                                    { return lcd[row < vb_lcd_rows?row:0]; }
+        VB_REGS     reg;
+    private:
+        void        edge(uint8_t irq, uint8_t old_level, uint8_t new_level);
+        void        callISR(uint8_t irq);
+        void        adcStart(void);                                         // Start the conversion requested by the firmware
+        void        adcComplete(void);
+        uint64_t    compareTime(void);                                      // The time of the next Timer0 compare match, zero - disabled
+        uint64_t    bottomTime(void);                                       // The time the buffered OCR0A is loaded, zero - nothing to load
+        bool        ocr0aBuffered(void)                                     { return reg.tccr0a & 0x01; }        // WGM00, the PWM modes
+        void        raise(uint8_t vect);                                    // Call the peripheral interrupt handler or make it pending
+        void        callVector(uint8_t vect);
+        uint64_t    now_us;                                                 // The virtual time in microseconds
+        uint64_t    next_sync;                                              // The time of the next AC sync pulse
+        uint16_t    half_period;                                            // AC half-period (us)
+        HOOK_CB     half_cycle_cb;
+        void*       half_cycle_ctx;
+        uint8_t     mode[vb_pins];
+        uint8_t     out_level[vb_pins];                                     // Levels written by the firmware
+        uint8_t     in_level[vb_pins];                                      // Levels driven from outside
+        uint16_t    analog[vb_pins - vb_analog_first];
+        uint8_t     aref;                                                   // The reference set by analogReference(), AREF is driven if EXTERNAL
+        ADC_CB      adc_cb;
+        void*       adc_ctx;
+        HOOK_CB     vect_hook[vb_vectors];                                  // The peripheral interrupt handlers set by vectorHook()
+        void*       vect_ctx[vb_vectors];
+        uint8_t     vect_pending;                                           // Bitmap of the peripheral interrupts raised while disabled
+        uint64_t    adc_done;                                               // The time the conversion completes, zero - no conversion
+        uint8_t     ocr0a;                                                  // The OCR0A value the counter is compared with in the PWM modes
+        void        (*isr[vb_irqs])(void);
+        int         isr_mode[vb_irqs];
+        bool        irq_enabled;
+        uint8_t     irq_pending;                                            // Bitmap of the interrupts raised while disabled
+        bool        in_isr;
+        uint8_t     eeprom[vb_eeprom_size];
+        FILE*       eeprom_file;
+        FILE*       serial_out;
+        char        rx[vb_serial_rx_size];                                  // The receive ring buffer
+        uint8_t     rx_head;
+        uint8_t     rx_len;
+        uint32_t    beep_count;
+        char        lcd[vb_lcd_rows][vb_lcd_cols+1];
+};
+
+extern thread_local VBOARD vboard;
+
+#endif
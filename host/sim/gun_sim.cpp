@@ -0,0 +1,47 @@
+#include "gun_sim.h"
+
+GUN_SIM::GUN_SIM(const PLANT_PARAMS &params, uint32_t seed) :
+    hg(sim_temp_pin, plant_heater_pin, plant_relay_pin), model(params, seed) {
+    period_cb   = 0;
+    period_ctx  = 0;
+    sync_us     = 0;
+    phase_err   = 0;
+}
+
+void GUN_SIM::init(void) {
+    vboard.reset();
+    vboard.setMains(uint16_t(plant_dt * 1e6));
+    vboard.vectorHook(VB_ADC_VECT, adcCB, this);
+    vboard.vectorHook(VB_TIMER0_COMPA_VECT, phaseCB, this);
+    model.reset();
+    model.attach();
+    analogReference(EXTERNAL);                                              // As setup() does
+    cfg.init();
+    hg.init();
+    uint16_t gs_temp[3];                                                    // The PID gain schedule as setup() does
+    cfg.scheduleTemp(gs_temp);
+    hg.gainSchedule(cfg.pidTable(), gs_temp);
+    hg.powerModel(cfg.powerTable(), gs_temp);
+}
+
+void GUN_SIM::phaseCB(void *ctx) {
+    GUN_SIM *s = (GUN_SIM *)ctx;
+    s->hg.phaseCB();
+    if (TIMSK0 & _BV(OCIE0A)) return;                                       // Counting the Timer0 rounds
+    int32_t  phase = int32_t(vboard.now() - s->sync_us);
+    uint32_t err   = abs(phase - int32_t(s->hg.samplePhase()));
+    if (err > s->phase_err) s->phase_err = err;
+}
+
+void GUN_SIM::run(double seconds, RESPONSE *resp) {
+    uint32_t half_cycles = uint32_t(seconds / plant_dt + 0.5);
+    for (uint32_t i = 0; i < half_cycles; ++i) {
+        vboard.advance(uint32_t(plant_dt * 1e6));                           // The plant is integrated by the half-cycle hook
+        sync_us = vboard.now();
+        if (hg.syncCB()) {
+            hg.keepTemp();
+            if (period_cb) (*period_cb)(period_ctx, this);
+        }
+        if (resp) resp->sample(time(), model.airTemp());
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef _GUN_SIM_H_
+#define _GUN_SIM_H_
+
+#include <Arduino.h>
+#include "gun.h"
+#include "config.h"
+#include "plant.h"
+#include "response.h"
+
+//------------------------------------------ Closed loop simulation of the Hot Air Gun -----------------------
+/* The firmware HOTGUN controller coupled with the thermal plant model on the virtual board of the current thread.
+ * Every AC half-cycle the plant is integrated and HOTGUN_HW::syncCB() is called as the AC sync interrupt does,
+ * HOTGUN::keepTemp() is called at the end of the control period as loop() does. The ADC conversion complete
+ * and the Timer0 compare match interrupts of the virtual board call HOTGUN_HW::adcCB() and HOTGUN_HW::phaseCB()
+ * as the ISR() handlers of the sketch do. The deviation of the ADC burst start from the sample phase after the AC sync
+ * edge (see HOTGUN_HW::samplePhase()) is watched.
+ */
+const uint8_t sim_temp_pin = 14;                                            // A0, see hot_air_gun.ino
+
+class GUN_SIM {
+    public:
+        typedef void    (*PERIOD_CB)(void *ctx, GUN_SIM *sim);
+        GUN_SIM(const PLANT_PARAMS &params = plant_nominal, uint32_t seed = 1);
+        void            init(void);                                         // Power-on: cold plant, the firmware objects initialized
+        void            powerOn(bool on)                                    { hg.switchPower(on);                   }
+        void            setTemp(uint16_t celsius)                           { hg.setTemp(cfg.tempInternal(celsius)); }
+        void            setFan(uint16_t fan)                                { hg.setFan(fan);                       }
+        void            run(double seconds, RESPONSE *resp = 0);            // Simulate the time, collect the air temperature
+        void            onPeriod(PERIOD_CB cb, void *ctx)                   { period_cb = cb; period_ctx = ctx;     }
+        double          time(void)                                          { return vboard.now() * 1e-6;           }
+        HOTGUN&         gun(void)                                           { return hg;                            }
+        HOTGUN_CFG&     config(void)                                        { return cfg;                           }
+        PLANT&          plant(void)                                         { return model;                         }
+        uint32_t        phaseError(void)                                    { return phase_err;                     }   // The maximum, us
+    private:
+        static void     adcCB(void *ctx)                                    { ((GUN_SIM *)ctx)->hg.adcCB();         }
+        static void     phaseCB(void *ctx);
+        HOTGUN          hg;
+        HOTGUN_CFG      cfg;
+        PLANT           model;
+        uint64_t        sync_us;                                            // The time of the last AC sync edge
+        uint32_t        phase_err;                                          // The maximum deviation of the burst start, us
+        PERIOD_CB       period_cb;                                          // Called after every HOTGUN::keepTemp()
+        void*           period_ctx;
+};
+
+#endif
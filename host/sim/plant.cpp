@@ -0,0 +1,106 @@
+#include <math.h>
+#include <string.h>
+#include "vboard.h"
+#include "plant.h"
+
+const PLANT_PARAMS plant_nominal = {
+    600.0,                                                                  // heater_power
+    1.0,                                                                    // mains_voltage
+    12.0,                                                                   // heat_capacity
+    0.3,                                                                    // loss_still
+    1.0,                                                                    // loss_fan
+    0.5,                                                                    // dead_time
+    1.0,                                                                    // sensor_tau
+    1.0,                                                                    // sensor_gain
+    25.0,                                                                   // ambient
+    1.0,                                                                    // adc_noise
+    40.0,                                                                   // switch_spike
+    0.0002                                                                  // switch_tau
+};
+
+// The default calibration curve of the firmware: Celsius -> ADC reading (see HOTGUN_CFG::def_tip)
+static const double curve_t[]   = {  25.0, 200.0, 300.0, 400.0 };
+static const double curve_adc[] = {  67.0, 587.0, 751.0, 850.0 };
+static const uint8_t curve_len  = sizeof(curve_t) / sizeof(curve_t[0]);
+
+PLANT::PLANT(const PLANT_PARAMS &params, uint32_t seed) {
+    p           = params;
+    this->seed  = seed;
+    reset();
+}
+
+void PLANT::reset(void) {
+    t_air       = p.ambient;
+    t_sensor    = p.ambient;
+    adc_clean   = adcValue(t_sensor, p.sensor_gain);
+    joules      = 0.0;
+    delay_len   = uint16_t(p.dead_time / plant_dt + 0.5);
+    if (delay_len < 1)   delay_len = 1;
+    if (delay_len > 256) delay_len = 256;
+    delay_pos   = 0;
+    sync_us     = 0;
+    was_on      = false;
+    sensor_open = false;
+    memset(delay_line, 0, sizeof(delay_line));
+    rnd         = 0x9E3779B97F4A7C15ULL ^ seed;
+}
+
+void PLANT::step(double dt, bool heater_on, uint16_t fan) {
+    double power = heater_on?p.heater_power * p.mains_voltage * p.mains_voltage:0.0;
+    joules += power * dt;
+    double delayed  = delay_line[delay_pos];                                // The power applied delay_len half-cycles ago
+    delay_line[delay_pos] = power;
+    if (++delay_pos >= delay_len) delay_pos = 0;
+    double airflow  = fan / 1999.0;                                         // max_fan_speed, see vars.cpp
+    if (airflow > 1.0) airflow = 1.0;
+    double loss     = (p.loss_still + p.loss_fan * airflow) * (t_air - p.ambient);
+    t_air          += (delayed - loss) * dt / p.heat_capacity;
+    t_sensor       += (t_air - t_sensor) * dt / (p.sensor_tau + dt);
+    adc_clean       = adcValue(t_sensor, p.sensor_gain);
+}
+
+uint16_t PLANT::adc(double shift) {
+    if (sensor_open) return 1023;
+    double v = adc_clean + shift + gauss() * p.adc_noise;
+    if (v < 0.0)    v = 0.0;
+    if (v > 1023.0) v = 1023.0;
+    return uint16_t(v + 0.5);
+}
+
+double PLANT::adcValue(double celsius, double gain) {
+    uint8_t i = 1;
+    while (i < curve_len - 1 && celsius > curve_t[i]) ++i;                  // Extrapolate by the outer segments
+    double v = curve_adc[i-1] + (celsius - curve_t[i-1]) * (curve_adc[i] - curve_adc[i-1]) / (curve_t[i] - curve_t[i-1]);
+    return curve_adc[0] + (v - curve_adc[0]) * gain;
+}
+
+double PLANT::gauss(void) {                                                 // Irwin-Hall: the summ of 4 uniform values over xorshift64
+    rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+    uint32_t summ = 0;
+    for (uint8_t i = 0; i < 4; ++i)
+        summ += (rnd >> (16 * i)) & 0xFFFF;
+    return (double(summ) / 65536.0 - 2.0) * 1.7320508075688772;            // Zero mean, variance 4/12 scaled to 1
+}
+
+void PLANT::attach(void) {
+    vboard.adcSource(adcCB, this);
+    vboard.onHalfCycle(halfCycleCB, this);
+}
+
+uint16_t PLANT::adcCB(void *ctx, uint8_t pin) {
+    (void)pin;
+    PLANT *m = (PLANT *)ctx;
+    bool on = vboard.output(plant_heater_pin) && vboard.output(plant_relay_pin);
+    double shift = 0.0;
+    if (on && !m->was_on && m->p.switch_tau > 0.0)                          // The heater has been switched on in this half-cycle
+        shift = m->p.switch_spike * exp(-double(vboard.now() - m->sync_us) * 1e-6 / m->p.switch_tau);
+    return m->adc(shift);
+}
+
+void PLANT::halfCycleCB(void *ctx) {
+    PLANT *m = (PLANT *)ctx;
+    bool on = vboard.output(plant_heater_pin) && vboard.output(plant_relay_pin);
+    m->step(plant_dt, on, vboard.reg.ocr1a);
+    m->was_on   = on;
+    m->sync_us  = vboard.now();
+}
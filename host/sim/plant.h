@@ -0,0 +1,68 @@
+#ifndef _PLANT_H_
+#define _PLANT_H_
+
+#include <stdint.h>
+
+//------------------------------------------ Hot Air Gun thermal plant model ---------------------------------
+/* The lumped model of the heater and the air flow:
+ *   C * dT/dt = P(t - dead_time) - (loss_still + loss_fan * fan/max_fan) * (T - T_amb)
+ * The thermocouple follows the air temperature with the first order lag (sensor_tau).
+ * The sensor reading is converted to the ADC value by the piecewise linear curve through the default
+ * calibration points of the firmware (see HOTGUN_CFG::def_tip), scaled by sensor_gain, plus gaussian noise.
+ * The firmware oversamples the ADC (16 conversions per AC half-cycle, see HOTGUN_HW), so the noise is the cheap
+ * Irwin-Hall approximation and the noiseless reading is calculated once per half-cycle.
+ * When the triac switches the heater on at the zero crossing, the current step couples into the thermocouple
+ * amplifier: the readings of that half-cycle are shifted by switch_spike decaying with switch_tau.
+ */
+struct PLANT_PARAMS {
+    double      heater_power;                                               // Heater power at full AC voltage, W
+    double      mains_voltage;                                              // Relative mains voltage, 1.0 - nominal
+    double      heat_capacity;                                              // Heater and nozzle thermal capacity, J/K
+    double      loss_still;                                                 // Heat loss without air flow, W/K
+    double      loss_fan;                                                   // Additional heat loss at maximum fan speed, W/K
+    double      dead_time;                                                  // Transport delay from the heater to the sensor, s
+    double      sensor_tau;                                                 // Thermocouple time constant, s
+    double      sensor_gain;                                                // Thermocouple & amplifier gain relative to nominal
+    double      ambient;                                                    // Ambient temperature, Celsius
+    double      adc_noise;                                                  // ADC noise standard deviation, ADC counts
+    double      switch_spike;                                               // The reading shift when the heater switches on, ADC counts
+    double      switch_tau;                                                 // The decay of the switching shift, s
+};
+
+extern const PLANT_PARAMS plant_nominal;
+
+const double    plant_dt            = 0.01;                                 // The AC half-period (50 Hz mains), s
+const uint8_t   plant_heater_pin    = 7;                                    // The pins the firmware drives the heater by, see hot_air_gun.ino
+const uint8_t   plant_relay_pin     = 12;
+
+class PLANT {
+    public:
+        PLANT(const PLANT_PARAMS &params, uint32_t seed = 1);
+        void        reset(void);                                            // Cold gun at ambient temperature
+        void        step(double dt, bool heater_on, uint16_t fan);          // Integrate the model over dt seconds
+        uint16_t    adc(double shift = 0.0);                                // The noisy ADC reading of the thermocouple
+        double      airTemp(void)                                   const   { return t_air;     }
+        double      sensorTemp(void)                                const   { return t_sensor;  }
+        double      energy(void)                                    const   { return joules;    }   // Energy supplied to the heater, J
+        void        sensorOpen(bool open)                                   { sensor_open = open; } // The broken thermocouple: the amplifier saturates
+        const PLANT_PARAMS& params(void)                            const   { return p;         }
+        void        attach(void);                                           // Drive the model by the virtual board: AC half-cycles, heater pins & fan PWM
+        static double adcValue(double celsius, double gain = 1.0);          // Noiseless ADC reading of the sensor at given temperature
+    private:
+        static uint16_t adcCB(void *ctx, uint8_t pin);
+        static void     halfCycleCB(void *ctx);
+        double      gauss(void);
+        PLANT_PARAMS p;
+        double      t_air, t_sensor;
+        double      adc_clean;                                              // The noiseless reading of t_sensor
+        double      joules;
+        double      delay_line[256];                                        // Heater power history by AC half-cycles to model the dead time, W
+        uint16_t    delay_len, delay_pos;
+        uint64_t    sync_us;                                                // The time of the last AC half-cycle start
+        bool        was_on;                                                 // The heater state of the previous half-cycle
+        bool        sensor_open;                                            // Every reading is 1023
+        uint64_t    rnd;                                                    // xorshift64 generator state
+        uint32_t    seed;
+};
+
+#endif
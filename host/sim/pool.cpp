@@ -0,0 +1,58 @@
+#include "pool.h"
+
+THREAD_POOL::THREAD_POOL(unsigned threads) {
+    job     = 0;
+    ctx     = 0;
+    count   = 0;
+    next    = 0;
+    busy    = 0;
+    batch   = 0;
+    stop    = false;
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        workers.push_back(std::thread(&THREAD_POOL::worker, this));
+}
+
+THREAD_POOL::~THREAD_POOL() {
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+void THREAD_POOL::run(JOB job, void *ctx, size_t count) {
+    if (count == 0) return;
+    std::unique_lock<std::mutex> l(lock);
+    this->job   = job;
+    this->ctx   = ctx;
+    this->count = count;
+    next        = 0;
+    busy        = unsigned(workers.size());
+    ++batch;
+    start_cv.notify_all();
+    done_cv.wait(l, [this]{ return busy == 0; });
+}
+
+void THREAD_POOL::worker(void) {
+    uint64_t done = 0;                                                      // The last batch processed by this worker
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> l(lock);
+            start_cv.wait(l, [this, done]{ return stop || batch != done; });
+            if (stop) return;
+            done = batch;
+        }
+        work();
+        std::lock_guard<std::mutex> l(lock);
+        if (--busy == 0) done_cv.notify_one();
+    }
+}
+
+void THREAD_POOL::work(void) {
+    for (size_t i = next++; i < count; i = next++)
+        (*job)(ctx, i);
+}
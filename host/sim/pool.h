@@ -0,0 +1,39 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//------------------------------------------ Fixed size thread pool ------------------------------------------
+/* Runs the batch of independent jobs job(ctx, 0) ... job(ctx, count-1) on all the worker threads and waits
+ * for the batch to complete. The jobs are taken by the threads one by one, so long and short jobs are balanced.
+ * Every worker thread has its own virtual board (see vboard.h), so every job can run the simulation.
+ */
+class THREAD_POOL {
+    public:
+        typedef void    (*JOB)(void *ctx, size_t index);
+        THREAD_POOL(unsigned threads = 0);                                  // 0 - the number of the CPU cores
+        ~THREAD_POOL();
+        void            run(JOB job, void *ctx, size_t count);
+        unsigned        size(void)                                  const   { return unsigned(workers.size()); }
+    private:
+        void            worker(void);
+        void            work(void);
+        std::vector<std::thread>    workers;
+        std::mutex                  lock;
+        std::condition_variable     start_cv, done_cv;
+        JOB                         job;
+        void*                       ctx;
+        size_t                      count;
+        std::atomic<size_t>         next;                                   // The next job index to take
+        unsigned                    busy;                                   // The number of workers in the batch
+        uint64_t                    batch;                                  // The batch number, to wake up the workers
+        bool                        stop;
+};
+
+#endif
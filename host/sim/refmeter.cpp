@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <Arduino.h>
+#include "refmeter.h"
+
+const REF_METER_PARAMS ref_meter_nominal = {
+    0.0,                                                                    // offset
+    0.3,                                                                    // noise
+    500                                                                     // period
+};
+
+REF_METER_SIM::REF_METER_SIM(const PLANT &plant, const REF_METER_PARAMS &params, uint32_t seed) : plant(plant), p(params) {
+    on      = false;
+    next_us = 0;
+    count   = 0;
+    rnd     = uint64_t(seed) * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+void REF_METER_SIM::enable(bool on) {
+    this->on    = on;
+    next_us     = vboard.now() + uint64_t(p.period) * 1000;
+}
+
+void REF_METER_SIM::poll(void) {
+    if (!on || vboard.now() < next_us) return;
+    next_us += uint64_t(p.period) * 1000;
+    double t = plant.airTemp() + p.offset + gauss() * p.noise;
+    if (t < 0.0) t = 0.0;
+    char line[16];
+    int len = snprintf(line, sizeof(line), "%.1f\r\n", t);
+    vboard.serialFeed(line, len);
+    ++count;
+}
+
+double REF_METER_SIM::gauss(void) {                                         // Irwin-Hall, see PLANT::gauss()
+    rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+    uint32_t summ = 0;
+    for (uint8_t i = 0; i < 4; ++i)
+        summ += (rnd >> (16 * i)) & 0xFFFF;
+    return (double(summ) / 65536.0 - 2.0) * 1.7320508075688772;
+}
@@ -0,0 +1,38 @@
+#ifndef _REFMETER_H_
+#define _REFMETER_H_
+
+#include <stdint.h>
+#include "plant.h"
+
+//------------------------------------------ The reference thermometer stand-in -------------------------------
+/* Emulates the external thermocouple meter connected to the serial port of the board (see REF_METER in autocalib.h).
+ * The meter measures the air temperature of the plant model with its own offset and noise, rounds it to tenths
+ * of Celsius and sends the line "<Celsius>.<tenths>\r\n" every 'period' ms into the board receive buffer.
+ */
+struct REF_METER_PARAMS {
+    double      offset;                                                     // The meter error, Celsius
+    double      noise;                                                      // The reading noise standard deviation, Celsius
+    uint16_t    period;                                                     // The time between readings, ms
+};
+
+extern const REF_METER_PARAMS ref_meter_nominal;
+
+class REF_METER_SIM {
+    public:
+        REF_METER_SIM(const PLANT &plant, const REF_METER_PARAMS &params = ref_meter_nominal, uint32_t seed = 7);
+        void        enable(bool on);                                        // The meter sends the readings from now
+        bool        enabled(void)                                   const   { return on;        }
+        void        poll(void);                                             // Send the reading if the time has come
+        uint64_t    due(void)                                       const   { return next_us;   }   // The time of the next reading, us
+        uint32_t    sent(void)                                      const   { return count;     }
+    private:
+        double      gauss(void);
+        const PLANT&        plant;
+        REF_METER_PARAMS    p;
+        bool        on;
+        uint64_t    next_us;
+        uint32_t    count;
+        uint64_t    rnd;                                                    // xorshift64 generator state
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include <math.h>
+#include "response.h"
+
+void RESPONSE::start(double t0, double from, double target) {
+    this->t0        = t0;
+    this->from      = from;
+    this->target    = target;
+    samples.clear();
+}
+
+void RESPONSE::sample(double t, double temp) {
+    SAMPLE s = { t, temp };
+    samples.push_back(s);
+}
+
+RESPONSE_STAT RESPONSE::result(void) const {
+    RESPONSE_STAT r = { -1.0, 0.0, -1.0, 0.0, 0.0 };
+    if (samples.empty()) return r;
+
+    double step     = target - from;
+    double dir      = (step >= 0)?1.0:-1.0;
+    double t10 = -1.0, t90 = -1.0;
+    double last_out = t0;                                                   // The last time the temperature was out of the band
+    bool   settled  = true;
+    double prev_t   = t0;
+    double summ     = 0.0;                                                  // Moving average of the temperature over avg_window
+    size_t first    = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const SAMPLE &s = samples[i];
+        summ += s.temp;
+        while (samples[first].t <= s.t - avg_window)
+            summ -= samples[first++].temp;
+        double temp = summ / double(i - first + 1);
+        double err = temp - target;
+        if (fabs(step) >= band) {
+            double done = (temp - from) / step;                             // Part of the step done
+            if (t10 < 0 && done >= 0.1) t10 = s.t;
+            if (t90 < 0 && done >= 0.9) t90 = s.t;
+            if (err * dir > r.overshoot) r.overshoot = err * dir;
+        } else {
+            if (fabs(err) > r.overshoot) r.overshoot = fabs(err);
+        }
+        if (fabs(err) > band) {
+            last_out = s.t;
+            settled  = (i + 1 < samples.size());
+        }
+        r.iae  += fabs(err) * (s.t - prev_t);
+        prev_t  = s.t;
+    }
+    if (t10 >= 0 && t90 >= 0) r.rise = t90 - t10;
+    if (settled) r.settling = last_out - t0;
+
+    double t_end = samples.back().t;
+    double lo = 1e9, hi = -1e9;
+    for (size_t i = samples.size(); i-- > 0 && samples[i].t >= t_end - window; ) {
+        if (samples[i].temp < lo) lo = samples[i].temp;
+        if (samples[i].temp > hi) hi = samples[i].temp;
+    }
+    r.ripple = hi - lo;
+    return r;
+}
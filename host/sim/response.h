@@ -0,0 +1,42 @@
+#ifndef _RESPONSE_H_
+#define _RESPONSE_H_
+
+#include <vector>
+
+//------------------------------------------ Step response quality metrics -----------------------------------
+/* Collects the temperature samples after the setpoint step (or the disturbance, when from == target)
+ * and calculates the standard control loop quality figures. All the figures but ripple are calculated
+ * on the temperature averaged over the power period (1 second), so the ripple of the heater bursts
+ * does not hide the settling:
+ *  rise        - time from 10% to 90% of the step, s (negative if not applicable or not reached)
+ *  overshoot   - the maximum excursion beyond the target in the step direction, Celsius
+ *                (maximum deviation from the target for the disturbance)
+ *  settling    - time after the step when the temperature enters the band around the target for good, s
+ *                (negative if the temperature has not settled)
+ *  iae         - integral of the absolute error, Celsius*s
+ *  ripple      - peak-to-peak temperature in the last ripple_window seconds, Celsius
+ */
+struct RESPONSE_STAT {
+    double      rise;
+    double      overshoot;
+    double      settling;
+    double      iae;
+    double      ripple;
+};
+
+class RESPONSE {
+    public:
+        RESPONSE(double band = 5.0, double ripple_window = 20.0, double avg_window = 1.0) {
+            this->band = band; window = ripple_window; this->avg_window = avg_window; start(0, 0, 0);
+        }
+        void            start(double t0, double from, double target);       // The setpoint step (or disturbance) happened at t0
+        void            sample(double t, double temp);
+        RESPONSE_STAT   result(void) const;
+    private:
+        struct SAMPLE   { double t, temp; };
+        std::vector<SAMPLE> samples;
+        double          band, window, avg_window;
+        double          t0, from, target;
+};
+
+#endif
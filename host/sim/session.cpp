@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sketch.h"
+#include "session.h"
+
+const uint16_t  session_click_gap       = 400;                              // The time between encoder clicks, ms (slow rotation)
+const uint16_t  session_fast_click_gap  = 100;                              // Fast rotation, see RENC::fast_timeout
+const uint16_t  session_short_press     = 300;                              // ms
+const uint16_t  session_long_press      = 2000;
+
+bool SESSION::load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        snprintf(err, sizeof(err), "cannot open %s", path);
+        return false;
+    }
+    char line[128];
+    uint16_t n = 0;
+    actions.clear();
+    while (fgets(line, sizeof(line), f)) {
+        ++n;
+        if (!command(line)) {
+            snprintf(err, sizeof(err), "%s:%u: wrong command", path, n);
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+bool SESSION::command(const char *line) {
+    char cmd[16], arg[16], opt[16];
+    int args = sscanf(line, "%15s %15s %15s", cmd, arg, opt);
+    if (args <= 0 || cmd[0] == '#') return true;
+    ACTION a = { 0, 0 };
+    if (!strcmp(cmd, "wait") && args >= 2) {
+        a.cmd = 'w';
+        a.arg = int32_t(atof(arg) * 1000);
+    } else if (!strcmp(cmd, "reed") && args >= 2) {
+        a.cmd = 'r';
+        a.arg = !strcmp(arg, "on");
+    } else if (!strcmp(cmd, "rotate") && args >= 2) {
+        a.cmd = (args >= 3 && !strcmp(opt, "fast"))?'R':'o';
+        a.arg = atoi(arg);
+    } else if (!strcmp(cmd, "press") && args >= 2) {
+        a.cmd = 'p';
+        a.arg = !strcmp(arg, "long");
+    } else if (!strcmp(cmd, "meter") && args >= 2) {
+        a.cmd = 'm';
+        a.arg = !strcmp(arg, "on");
+    } else {
+        snprintf(err, sizeof(err), "wrong command: %s", cmd);
+        return false;
+    }
+    actions.push_back(a);
+    return true;
+}
+
+void SESSION::run(std::vector<SESSION_SAMPLE> &trace) {
+    vboard.setInput(sketch_pins.reed, LOW);                                 // The gun is in the holder
+    sketchStart();
+    plant.attach();
+    next_sample = 0;
+    for (size_t i = 0; i < actions.size(); ++i) {
+        const ACTION &a = actions[i];
+        switch (a.cmd) {
+            case 'w':
+                wait(a.arg, trace);
+                break;
+            case 'r':
+                vboard.setInput(sketch_pins.reed, a.arg?HIGH:LOW);
+                break;
+            case 'o':
+            case 'R':
+                for (int32_t c = 0; c < abs(a.arg); ++c)
+                    click((a.arg > 0)?1:-1, (a.cmd == 'R')?session_fast_click_gap:session_click_gap, trace);
+                break;
+            case 'm':
+                meter.enable(a.arg);
+                break;
+            case 'p':
+                vboard.setInput(sketch_pins.enc_button, LOW);
+                wait(a.arg?session_long_press:session_short_press, trace);
+                vboard.setInput(sketch_pins.enc_button, HIGH);
+                wait(100, trace);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void SESSION::wait(uint32_t ms, std::vector<SESSION_SAMPLE> &trace) {
+    uint64_t finish = vboard.now() + uint64_t(ms) * 1000;
+    while (vboard.now() < finish) {
+        if (vboard.now() >= next_sample) {
+            sample(trace);
+            next_sample += 1000000;
+        }
+        meter.poll();
+        uint64_t until = (next_sample < finish)?next_sample:finish;
+        if (meter.enabled() && meter.due() < until) until = meter.due();
+        sketchRun(uint32_t((until - vboard.now() + 999) / 1000));
+    }
+}
+
+// The encoder counts the click on the rising edge of the main channel; the secondary channel level,
+// read on the falling edge, gives the direction, see RENC::encoderIntr()
+void SESSION::click(int8_t dir, uint16_t gap_ms, std::vector<SESSION_SAMPLE> &trace) {
+    vboard.setInput(sketch_pins.enc_secd, (dir > 0)?LOW:HIGH);
+    vboard.setInput(sketch_pins.enc_main, LOW);
+    wait(5, trace);
+    vboard.setInput(sketch_pins.enc_main, HIGH);
+    wait(gap_ms - 5, trace);
+}
+
+void SESSION::sample(std::vector<SESSION_SAMPLE> &trace) {
+    SESSION_SAMPLE s;
+    s.time      = vboard.now() * 1e-6;
+    s.temp_set  = hgCfg.tempHuman(hg.presetTemp());
+    s.air       = plant.airTemp();
+    s.temp      = hg.averageTemp();
+    s.power     = hg.appliedPower();
+    s.fan       = hg.fanSpeed();
+    s.mode      = hg.powerMode();
+    s.energy    = plant.energy();
+    trace.push_back(s);
+}
@@ -0,0 +1,50 @@
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include <stdint.h>
+#include <vector>
+#include "plant.h"
+#include "refmeter.h"
+
+//------------------------------------------ Scripted operator session ---------------------------------------
+/* Runs the whole sketch with the plant model attached and plays the operator actions from the script:
+ *   wait <seconds>             let the firmware work
+ *   reed on|off                lift the gun from the holder (on) or put it back (off)
+ *   rotate <clicks> [fast]     rotate the encoder, negative clicks - counterclockwise
+ *   press short|long           press the encoder button
+ *   meter on|off               connect the reference thermometer to the serial port (see refmeter.h) or disconnect it
+ * Empty lines and the lines started with '#' are ignored.
+ * Every second of the virtual time the controller status is sampled.
+ */
+struct SESSION_SAMPLE {
+    double      time;                                                       // s
+    uint16_t    temp_set;                                                   // The preset temperature, Celsius
+    double      air;                                                        // The air temperature (plant model), Celsius
+    uint16_t    temp;                                                       // The averaged sensor reading, internal units
+    uint8_t     power;                                                      // Applied power, %
+    uint16_t    fan;                                                        // Fan PWM duty
+    uint8_t     mode;                                                       // HOTGUN power mode
+    double      energy;                                                     // Energy supplied to the heater since start, J
+};
+
+class SESSION {
+    public:
+        SESSION(const PLANT_PARAMS &params = plant_nominal, const REF_METER_PARAMS &meter_params = ref_meter_nominal)
+            : plant(params), meter(plant, meter_params) { }
+        bool        load(const char *path);                                 // Read the script
+        bool        command(const char *line);                              // Append one script line, false if it is wrong
+        void        run(std::vector<SESSION_SAMPLE> &trace);                // Run the sketch with the script, once per process!
+        const char* error(void)                                     const   { return err; }
+    private:
+        struct ACTION   { char cmd; int32_t arg; };
+        void        wait(uint32_t ms, std::vector<SESSION_SAMPLE> &trace);
+        void        click(int8_t dir, uint16_t gap_ms, std::vector<SESSION_SAMPLE> &trace);
+        void        sample(std::vector<SESSION_SAMPLE> &trace);
+        std::vector<ACTION> actions;
+        PLANT       plant;
+        REF_METER_SIM meter;
+        uint64_t    next_sample;                                            // Virtual time of the next sample, us
+        char        err[128];
+};
+
+#endif
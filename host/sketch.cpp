@@ -0,0 +1,22 @@
+#include <Arduino.h>
+#include "../hot_air_gun.ino"
+#include "sketch.h"
+
+const SKETCH_PINS sketch_pins = {
+    AC_SYNC_PIN, HOT_GUN_PIN, TEMP_GUN_PIN, FAN_GUN_PIN, AC_RELAY_PIN,
+    R_MAIN_PIN, R_SECD_PIN, R_BUTN_PIN,
+    REED_SW_PIN, BUZZER_PIN
+};
+
+void sketchStart(void) {
+    vboard.setMains(sketch_mains_us);
+    setup();
+}
+
+void sketchRun(uint32_t ms) {
+    uint64_t finish = vboard.now() + uint64_t(ms) * 1000;
+    while (vboard.now() < finish) {
+        loop();
+        vboard.advance(sketch_loop_us);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef _SKETCH_H_
+#define _SKETCH_H_
+
+#include <Arduino.h>
+#include "gun.h"
+#include "config.h"
+#include "encoder.h"
+#include "screen.h"
+
+//------------------------------------------ The firmware sketch built for the host ---------------------------
+/* hot_air_gun.ino compiled as is (see sketch.cpp). The objects below are defined in the sketch,
+ * sketchStart() and sketchRun() replace the Arduino main() function.
+ */
+struct SKETCH_PINS {
+    uint8_t     ac_sync, heater, temp, fan, relay;
+    uint8_t     enc_main, enc_secd, enc_button;
+    uint8_t     reed, buzzer;
+};
+
+extern const SKETCH_PINS    sketch_pins;
+extern HOTGUN               hg;
+extern HOTGUN_CFG           hgCfg;
+extern RENC                 rotEncoder;
+extern SCREEN*              pCurrentScreen;
+
+const uint16_t  sketch_loop_us  = 1000;                                     // The virtual time of one loop() call
+const uint16_t  sketch_mains_us = 10000;                                    // The AC half-period, 50 Hz mains
+
+void    setup(void);
+void    loop(void);
+void    sketchStart(void);                                                  // Supply AC power and run setup()
+void    sketchRun(uint32_t ms);                                             // Call loop() for specified virtual time
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Automatic calibration of the Hot Air Gun against the reference thermometer, simulated.
+ * Every unit is a plant variant (see plant.h) with its own thermocouple gain and heater power. The whole sketch
+ * runs with the reference thermometer stand-in on the serial port (see refmeter.h): the operator enters the setup menu,
+ * selects 'auto calib' and waits for the calibration to finish (see AUTO_CALIB in autocalib.h).
+ * Per unit: the calibration time and the maximum error of the displayed temperature against the air temperature
+ * over the calibrated range by the default calibration and by the automatic one. The sensor reading of the unit
+ * at the air temperature is the noiseless one.
+ * Usage: hg_autocal [-n units] [-s seed] [-g gain] [-m noise]
+ *   -n   the number of the units (20 by default)
+ *   -s   the random seed of the units
+ *   -g   the spread of the thermocouple gain, relative (0.05 by default)
+ *   -m   the noise of the reference thermometer, Celsius (see ref_meter_nominal)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+#include "sketch.h"
+#include "session.h"
+
+const uint32_t  autocal_timeout_s   = 3600;                                 // The time to wait for the calibration, s
+const uint16_t  autocal_menu_entry  = 1;                                    // The 'auto calib' item of the setup menu, see configSCREEN
+
+struct UNIT {
+    double      sensor_gain;
+    double      heater_power;                                               // W
+    bool        done;                                                       // The calibration finished successfully
+    double      time;                                                       // The calibration time, s
+    double      err_before;                                                 // The maximum error by the default calibration, Celsius
+    double      err_after;                                                  // The maximum error by the automatic calibration, Celsius
+};
+
+static double uniform(uint64_t &rnd, double nominal, double deviation) {   // See hg_robust
+    rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+    double u = double(rnd >> 11) / double(1ULL << 53);
+    return nominal + deviation * (2.0 * u - 1.0);
+}
+
+// The maximum error of the displayed temperature over the calibrated range, every 5 Celsius
+static double maxError(const PLANT_PARAMS &p) {
+    double err = 0;
+    for (uint16_t c = calib_tip[0]; c <= calib_tip[calib_points-1]; c += 5) {
+        uint16_t reading = uint16_t(PLANT::adcValue(c, p.sensor_gain) * 4.0 + 0.5);   // Internal units
+        double e = fabs(double(hgCfg.tempHuman(reading)) - c);
+        if (e > err) err = e;
+    }
+    return err;
+}
+
+// The sketch keeps its state in the global objects, so every unit runs in the separate process
+static bool runUnit(const PLANT_PARAMS &p, const REF_METER_PARAMS &m, UNIT &u) {
+    int fd[2];
+    if (pipe(fd) < 0) return false;
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(fd[0]);
+        hgCfg.init();                                                       // The default calibration, the EEPROM is empty
+        u.err_before = maxError(p);
+        SESSION s(p, m);
+        char wait[32];
+        snprintf(wait, sizeof(wait), "wait %u", autocal_timeout_s);
+        char rotate[32];
+        snprintf(rotate, sizeof(rotate), "rotate %u", autocal_menu_entry);
+        s.command("meter on");
+        s.command("press long");
+        s.command(rotate);
+        s.command("press short");
+        s.command(wait);
+        std::vector<SESSION_SAMPLE> trace;
+        s.run(trace);
+        double start = -1, finish = -1;
+        for (size_t i = 0; i < trace.size(); ++i) {
+            if (trace[i].mode != HOTGUN::POWER_ON) continue;
+            if (start < 0) start = trace[i].time;
+            finish = trace[i].time;
+        }
+        u.time      = (start < 0)?0:finish - start;
+        u.done      = strstr(vboard.lcdLine(1), "Failed") == 0 && finish < trace.back().time;
+        u.err_after = maxError(p);
+        bool ok = write(fd[1], &u, sizeof(u)) == sizeof(u);
+        _exit(ok?0:1);
+    }
+    close(fd[1]);
+    bool ok = read(fd[0], &u, sizeof(u)) == sizeof(u);
+    close(fd[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t            units   = 20;
+    uint32_t            seed    = 1;
+    double              gain    = 0.05;
+    REF_METER_PARAMS    m       = ref_meter_nominal;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:g:m:")) != -1) {
+        switch (opt) {
+            case 'n':
+                units = strtoul(optarg, 0, 10);
+                break;
+            case 's':
+                seed = strtoul(optarg, 0, 10);
+                break;
+            case 'g':
+                gain = atof(optarg);
+                break;
+            case 'm':
+                m.noise = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n units] [-s seed] [-g gain] [-m noise]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("%4s %8s %8s %8s %9s %9s %s\n", "unit", "gain", "heater", "time_s", "err_def", "err_auto", "result");
+    uint32_t failed = 0;
+    double   max_before = 0, max_after = 0, max_time = 0;
+    for (uint32_t i = 0; i < units; ++i) {
+        uint64_t rnd = 0x9E3779B97F4A7C15ULL * (i + 1) ^ seed;
+        for (uint8_t k = 0; k < 4; ++k) uniform(rnd, 0, 0);                // Mix the state
+        PLANT_PARAMS p  = plant_nominal;
+        p.sensor_gain   = uniform(rnd, p.sensor_gain,  p.sensor_gain  * gain);
+        p.heater_power  = uniform(rnd, p.heater_power, p.heater_power * 0.1);
+        UNIT u = { p.sensor_gain, p.heater_power, false, 0, 0, 0 };
+        if (!runUnit(p, m, u)) {
+            printf("%4u FAILED to run the unit\n", i + 1);
+            ++failed;
+            continue;
+        }
+        printf("%4u %8.3f %8.0f %8.0f %9.1f %9.1f %s\n", i + 1, u.sensor_gain, u.heater_power, u.time,
+            u.err_before, u.err_after, u.done?"done":"FAILED");
+        if (!u.done) {
+            ++failed;
+            continue;
+        }
+        if (u.err_before > max_before)  max_before  = u.err_before;
+        if (u.err_after  > max_after)   max_after   = u.err_after;
+        if (u.time       > max_time)    max_time    = u.time;
+    }
+    printf("%u units, %u failed; calibrated: max time %.0f s, max error %.1f C by default, %.1f C automatic\n",
+        units, failed, max_time, max_before, max_after);
+    return failed?1:0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Closed loop benchmark of the Hot Air Gun temperature controller on the simulated plant.
+ * Runs the standard scenarios and reports the step response figures, see response.h
+ * It fails if the ADC burst starts more than one Timer0 tick away from the sample phase after the AC sync edge,
+ * or if the heater is not switched off when the sensor breaks at the highest preset temperature.
+ * Usage: hg_bench_control [-p Kp,Ki,Kd] [-c]
+ *   -p   the fixed PID coefficients instead of the gain schedule (see pid_schedule in gun.h)
+ *   -c   print the result as CSV
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "gun_sim.h"
+
+struct SCENARIO {
+    const char* name;
+    uint16_t    temp;                                                       // Initial preset temperature, Celsius
+    uint16_t    fan;                                                        // Initial fan speed
+    double      warm_up;                                                    // Time to stabilize the temperature before the change, s
+    uint16_t    new_temp;                                                   // The preset temperature after the change
+    uint16_t    new_fan;                                                    // The fan speed after the change
+    double      duration;                                                   // Time to watch the response, s
+};
+
+static const SCENARIO scenarios[] = {
+    { "cold start 300C",    300, 1200,   0.0, 300, 1200, 180.0 },
+    { "step 300->350C",     300, 1200, 180.0, 350, 1200, 120.0 },
+    { "step 300->250C",     300, 1200, 180.0, 250, 1200, 120.0 },
+    { "fan min->max",       300,  600, 180.0, 300, 1999, 120.0 }
+};
+
+static int pid[3] = { -1, -1, -1 };
+
+static RESPONSE_STAT runScenario(const SCENARIO &s, uint32_t &phase_err) {
+    GUN_SIM     sim;
+    RESPONSE    resp;
+    sim.init();
+    for (uint8_t i = 0; i < 3; ++i)
+        if (pid[i] >= 0) sim.gun().changePID(i+1, pid[i]);
+    sim.setFan(s.fan);
+    sim.setTemp(s.temp);
+    sim.powerOn(true);
+    double from = sim.plant().airTemp();
+    if (s.warm_up > 0) {
+        sim.run(s.warm_up);
+        from = s.temp;
+        sim.setFan(s.new_fan);
+        sim.setTemp(s.new_temp);
+    }
+    resp.start(sim.time(), from, s.new_temp);
+    sim.run(s.duration, &resp);
+    phase_err = sim.phaseError();
+    return resp.result();
+}
+
+// The thermocouple breaks at the highest preset temperature: the reading runs away to the top of the range,
+// the over heating cutoff must switch the heater off. Returns the time the heater stays on after the break, s
+const double    runaway_limit   = 1.0;                                      // The history of 16 readings, 0.16 s, and one control period
+
+static double sensorRunaway(void) {
+    GUN_SIM     sim;
+    sim.init();
+    sim.setFan(600);
+    sim.setTemp(temp_maxC);
+    sim.powerOn(true);
+    sim.run(180.0);
+    sim.plant().sensorOpen(true);
+    double broken   = sim.time();
+    double on_time  = 0;
+    double energy   = sim.plant().energy();
+    for (uint16_t i = 0; i < 1000; ++i) {                                   // 10 s
+        sim.run(plant_dt);
+        if (sim.plant().energy() > energy) on_time = sim.time() - broken;
+        energy = sim.plant().energy();
+    }
+    return on_time;
+}
+
+int main(int argc, char *argv[]) {
+    bool csv = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c")) != -1) {
+        switch (opt) {
+            case 'p':
+                if (sscanf(optarg, "%d,%d,%d", &pid[0], &pid[1], &pid[2]) != 3) {
+                    fprintf(stderr, "Wrong PID coefficients: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                csv = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p Kp,Ki,Kd] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (csv)
+        printf("scenario,rise_s,overshoot_C,settling_s,iae_Cs,ripple_C\n");
+    else
+        printf("%-18s %8s %10s %10s %10s %8s\n", "scenario", "rise,s", "overshoot", "settle,s", "IAE,C*s", "ripple");
+    uint32_t phase_err = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        uint32_t err;
+        RESPONSE_STAT r = runScenario(scenarios[i], err);
+        if (err > phase_err) phase_err = err;
+        if (csv)
+            printf("%s,%.2f,%.2f,%.2f,%.1f,%.2f\n", scenarios[i].name, r.rise, r.overshoot, r.settling, r.iae, r.ripple);
+        else
+            printf("%-18s %8.2f %10.2f %10.2f %10.1f %8.2f\n", scenarios[i].name, r.rise, r.overshoot, r.settling, r.iae, r.ripple);
+    }
+    bool phase_ok = phase_err <= vb_timer0_tick_us;
+    if (!csv || !phase_ok)
+        printf("ADC burst phase error: %u us, %s\n", phase_err, phase_ok?"ok":"FAILED");
+    double on_time  = sensorRunaway();
+    bool runaway_ok = on_time <= runaway_limit;
+    if (!csv || !runaway_ok)
+        printf("Sensor runaway at %u C: the heater is on %.2f s after the break, %s\n", temp_maxC, on_time, runaway_ok?"ok":"FAILED");
+    return (phase_ok && runaway_ok)?0:1;
+}
@@ -0,0 +1,302 @@
+/*
+ * Microbenchmark of the firmware hot path primitives.
+ * Reports the host time per call and the executed operations per call (see opcount.h).
+ * The number of 32-bit divides is the key figure: every divide is a ~600 cycles library call on the AVR.
+ * The PID kernel (see pid.h) is compared with the former 'long' implementation (see pid_ref.h): both the cost
+ * and the result, the kernel must be bit-exact unless the 32-bit firmware arithmetic would overflow. Both at the
+ * rate 1 and at the default rate of the faster loop (see HOTGUN::controlPeriod()), where the power is divided by
+ * the reciprocal multiplication; the reciprocal is checked against the divide for every rate and power.
+ * The calibration tables (see config.h) are compared with the former map() conversion (see calib_ref.h)
+ * by random calibrations: tempHuman() must be bit-exact, tempInternal() must be the lowest internal temperature.
+ * Usage: hg_bench_prims [-n] [-c]
+ *   -n   do not count the operations (time only)
+ *   -c   print the result as CSV
+ * The exit code is not zero if the PID kernel, the reciprocal or the calibration conversion is not exact.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include "stat.h"
+#include "gun.h"
+#include "config.h"
+#include "opcount.h"
+#include "pid_ref.h"
+#include "calib_ref.h"
+
+volatile int32_t sink;                                                      // Keeps the results alive
+
+const uint8_t   pid_rate    = 10;                                           // The default PID iterations per power period
+
+// The PID of the faster loop
+class PID_RATE : public PID {
+    public:
+        PID_RATE(uint8_t r)                                                 { controlRate(r); }
+};
+
+struct CTX {
+    HIST<int16_t>   hist;
+    MEDIAN<int16_t> median;
+    EMP_AVERAGE     emp;
+    EMP_SHIFT<8>    emp_shift;
+    PID             pid;
+    PID_RATE        pid_rate    = PID_RATE(::pid_rate);
+    PID_REF         pid_ref;
+    HOTGUN_CFG      cfg;
+    uint16_t        i;
+};
+
+static void histRead(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->hist.read();
+}
+
+static void histDispersion(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->hist.dispersion();
+}
+
+static void histUpdate(void *p) {
+    CTX *c = (CTX *)p;
+    c->hist.update(2960 + (++c->i & 31));
+}
+
+static void medianFilter(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->median.filter(2960 + ((++c->i * 37) & 31));                  // The order of the window changes
+}
+
+static void empAverage(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->emp.average(40 + (++c->i & 15));
+}
+
+static void empShiftAverage(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->emp_shift.average(40 + (++c->i & 15));
+}
+
+static void pidReqPower(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->pid.reqPower(3004, 2980 + (++c->i % 49));
+}
+
+static void pidRateReqPower(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->pid_rate.reqPower(3004, 2980 + (++c->i % 49));
+}
+
+static void pidRefReqPower(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->pid_ref.reqPower(3004, 2980 + (++c->i % 49));
+}
+
+static void tempInternal(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->cfg.tempInternal(100 + (++c->i % 401));
+}
+
+static void tempHuman(void *p) {
+    CTX *c = (CTX *)p;
+    sink = c->cfg.tempHuman(200 + (++c->i % 3601));
+}
+
+struct BENCH {
+    const char*     name;
+    OPCOUNT::FUNC   func;
+};
+
+static const BENCH benches[] = {
+    { "HIST::update",               histUpdate      },
+    { "HIST::read",                 histRead        },
+    { "HIST::dispersion",           histDispersion  },
+    { "MEDIAN::filter",             medianFilter    },
+    { "EMP_AVERAGE::average",       empAverage      },
+    { "EMP_SHIFT<8>::average",      empShiftAverage },
+    { "PID::reqPower (rate 1)",     pidReqPower     },
+    { "PID::reqPower (rate 10)",    pidRateReqPower },
+    { "PID::reqPower (long)",       pidRefReqPower  },
+    { "HOTGUN_CFG::tempInternal",   tempInternal    },
+    { "HOTGUN_CFG::tempHuman",      tempHuman       }
+};
+
+static void prepare(CTX &c) {
+    c.i = 0;
+    c.cfg.init();                                                           // Blank EEPROM: default calibration
+    for (uint8_t i = 0; i < 16; ++i)
+        c.hist.update(2960 + i);
+    c.emp.length(200);                                                      // The former HOTGUN::d_power
+    c.pid.resetPID(2960);
+    c.pid_rate.resetPID(2960);
+    c.pid_ref.resetPID(2960);
+    for (uint8_t i = 0; i < 10; ++i) {                                      // Enter the iterative PID mode
+        c.pid.reqPower(3004, 2980);
+        c.pid_rate.reqPower(3004, 2980);
+        c.pid_ref.reqPower(3004, 2980);
+    }
+}
+
+// Feed the kernel and the reference with the same random temperature sequences around the preset temperature
+// with both the factory and random coefficients
+static bool pidEquivalence(uint8_t rate, bool csv) {
+    uint32_t    rnd     = 12345;
+    uint32_t    calls   = 0, mismatches = 0, overflows = 0;
+    const uint16_t sequences = 2000;
+    const uint16_t steps     = 400;
+    for (uint16_t s = 0; s < sequences; ++s) {
+        PID_RATE    pid(rate);
+        int16_t     k[3]    = { pid_kp, pid_ki, pid_kd };
+        if (s & 1) {                                                        // The range of pidSCREEN
+            for (uint8_t i = 0; i < 3; ++i) {
+                rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+                k[i] = (s & 2)?rnd % 10001:rnd % 501;
+                pid.changePID(i+1, k[i]);
+            }
+        }
+        PID_REF     ref(k[0], k[1], k[2], rate);
+        rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+        int temp_set    = 400 + rnd % 3600;
+        int temp        = 80 + (rnd >> 10) % 2400;
+        pid.resetPID(temp);
+        ref.resetPID(temp);
+        for (uint16_t i = 0; i < steps; ++i) {
+            long p  = pid.reqPower(temp_set, temp);
+            long r  = ref.reqPower(temp_set, temp);
+            ++calls;
+            if (ref.overflow()) {                                           // The firmware 'long' would overflow or the kernel saturates
+                ++overflows;
+                break;
+            }
+            if (p != r) {
+                if (mismatches++ < 10)
+                    fprintf(stderr, "PID kernel mismatch: rate %d, K=[%d,%d,%d], set %d, temp %d: %ld, expected %ld\n",
+                        rate, k[0], k[1], k[2], temp_set, temp, p, r);
+            }
+            rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+            int step = int(rnd % 81) - 40;                                  // The noise
+            if (s % 16 != 7)                                                // Sometimes the heater is broken, the integral winds up
+                step += (temp_set - temp) / 8;                              // Approach the preset temperature
+            temp = constrain(temp + step, 0, 4095);
+            if ((rnd >> 8) % 97 == 0) temp_set = 400 + (rnd >> 12) % 3600;  // Change the preset temperature sometimes
+        }
+    }
+    if (csv)
+        printf("pid_equivalence,%u,%u,%u,%u\n", rate, calls, mismatches, overflows);
+    else
+        printf("PID kernel equivalence at rate %u: %u calls, %u mismatches, %u sequences stopped at overflow or saturation\n",
+            rate, calls, mismatches, overflows);
+    return mismatches == 0;
+}
+
+// The reciprocal multiplication of PID_KERNEL::output() against the divide for every rate and non-negative power
+static bool reciprocalEquivalence(bool csv) {
+    uint32_t    mismatches  = 0;
+    for (uint16_t r = 2; r < 256; ++r) {
+        uint16_t    r_mul;
+        uint8_t     r_shift;
+        PID_Q13::reciprocal(r, r_mul, r_shift);
+        for (uint32_t u = 0; u < 32768; ++u) {
+            if (((u * r_mul) >> r_shift) != u / r) {
+                if (mismatches++ < 10)
+                    fprintf(stderr, "Reciprocal mismatch: %u / %u: %u\n", u, r, (u * r_mul) >> r_shift);
+            }
+        }
+    }
+    if (csv)
+        printf("reciprocal_equivalence,%u\n", mismatches);
+    else
+        printf("PID rate reciprocal: rates 2-255, power 0-32767, %u mismatches\n", mismatches);
+    return mismatches == 0;
+}
+
+// Every internal temperature and every Celsius temperature of the random calibrations and the default one
+static bool calibEquivalence(bool csv) {
+    uint32_t    rnd     = 54321;
+    uint32_t    human_mismatches = 0, internal_errors = 0, internal_changed = 0;
+    const uint16_t calibrations = 3000;
+    for (uint16_t c = 0; c < calibrations; ++c) {
+        HOTGUN_CFG  cfg;
+        cfg.init();                                                         // Blank EEPROM: default calibration
+        uint16_t    tip[max_calib_points];
+        if (c > 0) {                                                        // Ascending readings up to temp_max
+            uint16_t low = 269;
+            for (uint8_t i = 0; i < calib_points; ++i) {
+                uint16_t high = temp_max - (calib_points - 1 - i);
+                rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+                uint16_t span = (high - low) / (calib_points - i) * 2;      // The points spread over the whole range
+                tip[i] = low + rnd % (span + 1);
+                if (tip[i] > high) tip[i] = high;
+                low = tip[i] + 1;
+            }
+            cfg.applyCalibrationData(tip);
+        }
+        cfg.getCalibrationData(tip);
+        CALIB_REF   ref(tip);
+        for (uint16_t temp = 0; temp < 4096; ++temp) {
+            if (cfg.tempHuman(temp) != ref.tempHuman(temp)) {
+                if (human_mismatches++ < 10)
+                    fprintf(stderr, "tempHuman mismatch: tip [%d,..,%d], %d: %d, expected %d\n",
+                        tip[0], tip[calib_points-1], temp, cfg.tempHuman(temp), ref.tempHuman(temp));
+            }
+        }
+        for (uint16_t t = temp_minC; t <= temp_maxC; ++t) {
+            uint16_t temp = cfg.tempInternal(t);
+            bool reached  = (temp == 4095) || (ref.tempHuman(temp) >= t);
+            bool lowest   = (temp == 0) || (ref.tempHuman(temp-1) < t);
+            if (!reached || !lowest) {
+                if (internal_errors++ < 10)
+                    fprintf(stderr, "tempInternal error: tip [%d,..,%d], %d C: %d\n", tip[0], tip[calib_points-1], t, temp);
+            }
+            if (temp != ref.tempInternal(t)) ++internal_changed;
+        }
+    }
+    if (csv)
+        printf("calib_equivalence,%u,%u,%u,%u\n", calibrations, human_mismatches, internal_errors, internal_changed);
+    else
+        printf("Calibration tables: %u calibrations, %u tempHuman mismatches, %u tempInternal errors, "
+            "%u tempInternal differ from the binary search\n", calibrations, human_mismatches, internal_errors, internal_changed);
+    return human_mismatches == 0 && internal_errors == 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool count  = true;
+    bool csv    = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "nc")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = false;
+                break;
+            case 'c':
+                csv = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (csv)
+        printf("primitive,ns_per_call,instructions,div32,div_short,mul,mul_long\n");
+    else
+        printf("%-26s %10s %12s %8s %8s %8s %8s\n", "primitive", "ns/call", "instructions", "div32", "div8/16", "mul", "mul32");
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b) {
+        CTX c;
+        prepare(c);
+        double ns = nsPerCall(benches[b].func, &c);
+        OPCOUNT_STAT s = { -1, -1, -1, -1, -1 };
+        if (count) {
+            prepare(c);
+            if (!OPCOUNT::count(benches[b].func, &c, 401, s))
+                fprintf(stderr, "%s: cannot count the operations (ptrace is not permitted?)\n", benches[b].name);
+        }
+        if (csv)
+            printf("%s,%.2f,%.1f,%.2f,%.2f,%.2f,%.2f\n", benches[b].name, ns, s.instructions, s.div32, s.div_short, s.mul, s.mul_long);
+        else
+            printf("%-26s %10.2f %12.1f %8.2f %8.2f %8.2f %8.2f\n", benches[b].name, ns, s.instructions, s.div32, s.div_short, s.mul, s.mul_long);
+    }
+    bool pid_ok     = pidEquivalence(1, csv);
+    pid_ok         &= pidEquivalence(pid_rate, csv);
+    pid_ok         &= reciprocalEquivalence(csv);
+    bool calib_ok   = calibEquivalence(csv);
+    return (pid_ok && calib_ok)?0:1;
+}
@@ -0,0 +1,148 @@
+/*
+ * Spike rejection benchmark of the temperature readings filter (see MEDIAN in stat.h).
+ * The 12-bit ADC readings of the recorded event traces (see trace.h) are fed into the temperature history
+ * (HIST, the same as HOTGUN_HW::h_temp) directly and through the median filters of 3 and 5 readings.
+ * The spikes of the relay and triac edges are injected into the readings to compare the filters
+ * on the same trace; the clean readings without the filter are the reference.
+ * Per filter: the average and the 99th percentile of the dispersion (see HOTGUN_HW::tempDispersion()),
+ * the share of the readings the history is stable by the tuning screen threshold,
+ * and the maximum error of the average temperature against the reference.
+ * The cost per reading is reported by hg_bench_prims.
+ * Usage: hg_bench_spike [-i rate,amplitude,length] [-s seed] trace.txt ...
+ *   -i   the spikes per reading, the amplitude (internal units) and the length (readings), 0.01,400,1 by default
+ *   -s   the random seed of the spikes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include "stat.h"
+#include "trace.h"
+
+const uint32_t  stable_dispersion   = 160;                                  // See tuneSCREEN::show()
+
+struct SPIKES {
+    double      rate;
+    int         amplitude;
+    int         length;
+    uint64_t    seed;
+};
+
+struct FIGURES {
+    double      disp_avg;
+    uint32_t    disp_p99;
+    double      stable;                                                     // %
+    uint32_t    max_error;                                                  // Internal units
+};
+
+static bool loadReadings(const char *path, std::vector<int16_t> &adc) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char            type;
+        unsigned long   t;
+        unsigned        v;
+        if (line[0] != '#' || sscanf(line + 1, "%c %lu %u", &type, &t, &v) != 3) continue;
+        if (type == EVENT_TRACE::EV_ADC)
+            adc.push_back(int16_t(v));
+    }
+    fclose(f);
+    return true;
+}
+
+static uint64_t xorshift(uint64_t &rnd) {
+    rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+    return rnd;
+}
+
+static std::vector<int16_t> inject(const std::vector<int16_t> &clean, const SPIKES &s, uint32_t &injected) {
+    std::vector<int16_t> adc(clean);
+    uint64_t rnd = s.seed * 0x9E3779B97F4A7C15ULL + 1;
+    uint64_t threshold = uint64_t(s.rate * double(UINT32_MAX));
+    injected = 0;
+    for (size_t i = 0; i < adc.size(); ++i) {
+        if ((xorshift(rnd) & UINT32_MAX) >= threshold) continue;
+        int amp = (xorshift(rnd) & 1)?s.amplitude:-s.amplitude;
+        for (int j = 0; j < s.length && i < adc.size(); ++j, ++i)
+            adc[i] = int16_t(std::min(std::max(adc[i] + amp, 0), 4095));
+        ++injected;
+    }
+    return adc;
+}
+
+// The filter F is called for every reading before the history update
+template <typename F>
+static FIGURES measure(const std::vector<int16_t> &adc, const std::vector<int16_t> &clean, F filter) {
+    HIST<int16_t>   h, ref;
+    std::vector<uint32_t> disp;
+    FIGURES         r = { 0, 0, 0, 0 };
+    uint32_t        stable = 0;
+    for (size_t i = 0; i < adc.size(); ++i) {
+        h.update(filter(adc[i]));
+        ref.update(clean[i]);
+        uint32_t d = h.dispersion();
+        disp.push_back(d);
+        if (d < stable_dispersion) ++stable;
+        uint32_t e = abs(h.read() - ref.read());
+        if (e > r.max_error) r.max_error = e;
+    }
+    if (disp.empty()) return r;
+    double summ = 0;
+    for (uint32_t d : disp) summ += d;
+    r.disp_avg  = summ / disp.size();
+    std::sort(disp.begin(), disp.end());
+    r.disp_p99  = disp[size_t(0.99 * (disp.size() - 1) + 0.5)];
+    r.stable    = 100.0 * stable / disp.size();
+    return r;
+}
+
+static void report(const char *name, const FIGURES &f) {
+    printf("  %-16s %10.1f %10u %9.1f%% %10u\n", name, f.disp_avg, f.disp_p99, f.stable, f.max_error);
+}
+
+int main(int argc, char *argv[]) {
+    SPIKES s = { 0.01, 400, 1, 1 };
+    int opt;
+    while ((opt = getopt(argc, argv, "i:s:")) != -1) {
+        switch (opt) {
+            case 'i':
+                if (sscanf(optarg, "%lf,%d,%d", &s.rate, &s.amplitude, &s.length) != 3 || s.length < 1) {
+                    fprintf(stderr, "Wrong spikes: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                s.seed = strtoull(optarg, 0, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-i rate,amplitude,length] [-s seed] trace.txt ...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-i rate,amplitude,length] [-s seed] trace.txt ...\n", argv[0]);
+        return 1;
+    }
+
+    for (int a = optind; a < argc; ++a) {
+        std::vector<int16_t> clean;
+        if (!loadReadings(argv[a], clean)) {
+            fprintf(stderr, "Cannot read the trace file %s\n", argv[a]);
+            return 1;
+        }
+        uint32_t injected;
+        std::vector<int16_t> adc = inject(clean, s, injected);
+        printf("%s: %u readings, %u spikes of %d units x %d readings\n", argv[a], unsigned(clean.size()),
+            injected, s.amplitude, s.length);
+        printf("  %-16s %10s %10s %10s %10s\n", "filter", "disp avg", "disp p99", "stable", "max error");
+        MEDIAN<int16_t, 3> m3;
+        MEDIAN<int16_t, 5> m5;
+        report("clean",     measure(clean, clean, [](int16_t v) { return v; }));
+        report("none",      measure(adc, clean, [](int16_t v) { return v; }));
+        report("median 3",  measure(adc, clean, [&m3](int16_t v) { return m3.filter(v); }));
+        report("median 5",  measure(adc, clean, [&m5](int16_t v) { return m5.filter(v); }));
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Run the firmware on the virtual board and print the LCD content once per second of the virtual time.
+ * Usage: hg_host [-t seconds] [-a adc | -p] [-e eeprom.bin] [-l] [-s]
+ *   -t   the virtual time to run, seconds (60 by default)
+ *   -a   the constant ADC reading of the temperature sensor (67, ambient temperature, by default)
+ *   -p   read the temperature from the thermal plant model driven by the heater, see plant.h
+ *   -e   the file to keep the EEPROM content between the runs
+ *   -l   the Hot Air Gun is lifted from the holder (reed switch open)
+ *   -s   copy serial port output to stdout
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sketch.h"
+#include "plant.h"
+
+int main(int argc, char *argv[]) {
+    uint32_t    run_time    = 60;
+    uint16_t    adc         = 67;
+    bool        lifted      = false;
+    bool        use_plant   = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:a:e:lps")) != -1) {
+        switch (opt) {
+            case 't':
+                run_time = atol(optarg);
+                break;
+            case 'a':
+                adc = atoi(optarg);
+                break;
+            case 'e':
+                if (!vboard.eepromFile(optarg)) {
+                    fprintf(stderr, "Cannot open EEPROM file %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                lifted = true;
+                break;
+            case 'p':
+                use_plant = true;
+                break;
+            case 's':
+                vboard.serialOut(stdout);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t seconds] [-a adc | -p] [-e eeprom.bin] [-l] [-s]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    PLANT plant(plant_nominal);
+    vboard.setAnalog(sketch_pins.temp, adc);
+    vboard.setInput(sketch_pins.reed, lifted?HIGH:LOW);
+    sketchStart();
+    if (use_plant) plant.attach();
+    char screen[2][vb_lcd_cols+1] = { "", "" };
+    for (uint32_t s = 0; s < run_time; ++s) {
+        sketchRun(1000);
+        if (strcmp(screen[0], vboard.lcdLine(0)) || strcmp(screen[1], vboard.lcdLine(1))) {
+            strcpy(screen[0], vboard.lcdLine(0));
+            strcpy(screen[1], vboard.lcdLine(1));
+            printf("%5u s |%s|%s| power %2d%%, fan %4d\n", s+1, screen[0], screen[1], hg.appliedPower(), hg.fanSpeed());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Golden trace regression harness of the temperature controller.
+ * Every session script (see session.h) is run through the whole sketch with the plant model. The per-second trace
+ * of the preset and air temperature, applied power and fan duty is compared with the golden trace recorded before:
+ * for every setpoint segment the settling time and the overshoot must be within the tolerance band
+ * of the golden values, and so must be the total energy of the session.
+ * Usage: hg_regress [-r] [-d dir] [-o dir] [session ...]
+ *   -r   record the golden traces instead of checking
+ *   -d   the directory with sessions/ and golden/ subdirectories (host/regress by default)
+ *   -o   write the traces of this run to the directory
+ *   session  the session names to run (all sessions listed in sessions/list.txt by default)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include "sketch.h"
+#include "session.h"
+#include "response.h"
+
+#ifndef HG_REGRESS_DIR
+#define HG_REGRESS_DIR "host/regress"
+#endif
+
+/*  Tolerance bands: the larger of absolute and relative value. The settling time is counted by whole seconds of
+ *  the trace and the PID loop of 10 Hz shifts it by a second or two on a harmless change, the overshoot rides on
+ *  the ripple of the air temperature of about 1.5 Celsius, the energy is integrated over the whole session and
+ *  moves by 1-2% only. A real regression, like the step twice slower or the overshoot of 5 Celsius, is well outside
+ *  of the bands. When a change moves a figure out of the band on purpose, re-record the golden traces by -r in the
+ *  separate commit that lists the changed figures and why.
+ */
+const double tol_settling_s     = 3.0;
+const double tol_settling_rel   = 0.10;
+const double tol_overshoot_c    = 2.0;
+const double tol_overshoot_rel  = 0.15;
+const double tol_energy_rel     = 0.03;
+const double segment_merge_s    = 3.0;                                      // Setpoint changes closer than this make one step
+
+struct SEGMENT {
+    double          start;                                                  // Time of the (last) setpoint change, s
+    double          from, target;                                           // Celsius
+    RESPONSE_STAT   stat;
+};
+
+static bool writeTrace(const char *path, const std::vector<SESSION_SAMPLE> &trace) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "time_s,set_C,air_C,temp,power,fan,mode,energy_J\n");
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const SESSION_SAMPLE &s = trace[i];
+        fprintf(f, "%.3f,%u,%.2f,%u,%u,%u,%u,%.1f\n", s.time, s.temp_set, s.air, s.temp, s.power, s.fan, s.mode, s.energy);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool readTrace(const char *path, std::vector<SESSION_SAMPLE> &trace) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        SESSION_SAMPLE s;
+        unsigned set, temp, power, fan, mode;
+        if (sscanf(line, "%lf,%u,%lf,%u,%u,%u,%u,%lf", &s.time, &set, &s.air, &temp, &power, &fan, &mode, &s.energy) != 8)
+            continue;                                                       // The header
+        s.temp_set = set; s.temp = temp; s.power = power; s.fan = fan; s.mode = mode;
+        trace.push_back(s);
+    }
+    fclose(f);
+    return !trace.empty();
+}
+
+// Split the trace into the setpoint segments while the gun is working and calculate the response figures
+static void segments(const std::vector<SESSION_SAMPLE> &trace, std::vector<SEGMENT> &segs) {
+    RESPONSE    resp;
+    bool        open        = false;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const SESSION_SAMPLE &s = trace[i];
+        bool working = (s.mode == HOTGUN::POWER_ON);
+        if (open && (!working || s.temp_set != segs.back().target)) {
+            if (working && s.time - segs.back().start < segment_merge_s) {  // The setpoint is still changing
+                segs.back().start   = s.time;
+                segs.back().target  = s.temp_set;
+                resp.start(s.time, segs.back().from, s.temp_set);
+                resp.sample(s.time, s.air);
+                continue;
+            }
+            segs.back().stat = resp.result();
+            open = false;
+        }
+        if (!open && working) {
+            SEGMENT seg = { s.time, s.air, double(s.temp_set), { -1, 0, -1, 0, 0 } };
+            segs.push_back(seg);
+            resp.start(s.time, seg.from, seg.target);
+            open = true;
+        }
+        if (open) resp.sample(s.time, s.air);
+    }
+    if (open) segs.back().stat = resp.result();
+}
+
+static bool within(double value, double golden, double abs_tol, double rel_tol, const char *name, const char *units) {
+    double band = fabs(golden) * rel_tol;
+    if (band < abs_tol) band = abs_tol;
+    bool ok = true;
+    const char *verdict = "ok";
+    if (golden < 0 || value < 0) {                                          // Not settled
+        ok = (value >= 0 || golden < 0);
+        verdict = ok?((value >= 0 && golden < 0)?"improved":"ok"):"WORSE";
+    } else if (value > golden + band) {
+        ok = false;
+        verdict = "WORSE";
+    } else if (value < golden - band) {
+        verdict = "improved";
+    }
+    printf("    %-10s %9.2f %s (golden %9.2f +/-%.2f) %s\n", name, value, units, golden, band, verdict);
+    return ok;
+}
+
+static bool compare(const std::vector<SESSION_SAMPLE> &run, const std::vector<SESSION_SAMPLE> &golden) {
+    std::vector<SEGMENT> rs, gs;
+    segments(run, rs);
+    segments(golden, gs);
+    bool ok = true;
+    if (rs.size() != gs.size()) {
+        printf("    the number of setpoint segments differs: %u, golden %u\n", (unsigned)rs.size(), (unsigned)gs.size());
+        return false;
+    }
+    for (size_t i = 0; i < rs.size(); ++i) {
+        printf("  segment %u: %.0f -> %.0f C at %.1f s\n", (unsigned)i + 1, rs[i].from, rs[i].target, rs[i].start);
+        ok &= within(rs[i].stat.settling,  gs[i].stat.settling,  tol_settling_s,  tol_settling_rel,  "settling",  "s");
+        ok &= within(rs[i].stat.overshoot, gs[i].stat.overshoot, tol_overshoot_c, tol_overshoot_rel, "overshoot", "C");
+    }
+    double e  = run.back().energy    * 1e-3;
+    double ge = golden.back().energy * 1e-3;
+    ok &= within(e, ge, 0.0, tol_energy_rel, "energy", "kJ");
+    if (run.back().mode != golden.back().mode) {
+        printf("    final power mode %u, golden %u\n", run.back().mode, golden.back().mode);
+        ok = false;
+    }
+    return ok;
+}
+
+// The sketch keeps its state in the global objects, so every session runs in the separate process
+static bool runSession(const std::string &script, const std::string &out) {
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        SESSION s;
+        if (!s.load(script.c_str())) {
+            fprintf(stderr, "%s\n", s.error());
+            _exit(1);
+        }
+        std::vector<SESSION_SAMPLE> trace;
+        s.run(trace);
+        _exit(writeTrace(out.c_str(), trace)?0:1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void listSessions(const std::string &dir, std::vector<std::string> &names) {
+    FILE *f = fopen((dir + "/sessions/list.txt").c_str(), "r");
+    if (!f) return;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char name[128];
+        if (sscanf(line, "%127s", name) == 1 && name[0] != '#')
+            names.push_back(name);
+    }
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    bool        record  = false;
+    std::string dir     = HG_REGRESS_DIR;
+    std::string out     = "";
+    int opt;
+    while ((opt = getopt(argc, argv, "rd:o:")) != -1) {
+        switch (opt) {
+            case 'r':
+                record = true;
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r] [-d dir] [-o dir] [session ...]\n", argv[0]);
+                return 1;
+        }
+    }
+    std::vector<std::string> names;
+    for (int i = optind; i < argc; ++i)
+        names.push_back(argv[i]);
+    if (names.empty())
+        listSessions(dir, names);
+    if (names.empty()) {
+        fprintf(stderr, "No sessions found in %s/sessions\n", dir.c_str());
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::string script  = dir + "/sessions/" + names[i] + ".txt";
+        std::string golden  = dir + "/golden/"   + names[i] + ".csv";
+        std::string result  = record?golden:(out + "/" + names[i] + ".csv");
+        if (!record && out.empty()) {                                       // Keep the trace until it is compared
+            char tmp[] = "/tmp/hg_regress_XXXXXX";
+            int fd = mkstemp(tmp);
+            if (fd >= 0) close(fd);
+            result = tmp;
+        }
+        printf("%s\n", names[i].c_str());
+        if (!runSession(script, result)) {
+            printf("  FAILED to run the session\n");
+            ++failed;
+            continue;
+        }
+        if (record) {
+            printf("  recorded %s\n", golden.c_str());
+            continue;
+        }
+        std::vector<SESSION_SAMPLE> r, g;
+        bool ok = readTrace(result.c_str(), r);
+        if (out.empty()) unlink(result.c_str());
+        if (!ok || !readTrace(golden.c_str(), g)) {
+            printf("  FAILED: no trace or no golden trace %s\n", golden.c_str());
+            ++failed;
+            continue;
+        }
+        ok = compare(r, g);
+        printf("  %s\n", ok?"PASS":"FAIL");
+        if (!ok) ++failed;
+    }
+    if (!record)
+        printf("%u sessions, %d failed\n", (unsigned)names.size(), failed);
+    return failed?1:0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Replay the input events recorded by the firmware (see trace.h) into the host build of the firmware.
+ * The AC sync pulses, ADC readings, encoder edges, button and reed switch levels are applied to the virtual board
+ * at the recorded time, loop() is called every millisecond between the events. The replay is deterministic.
+ * The ADC reading is recorded by the sync ISR when the burst of the conversions started by the previous pulse
+ * is decimated (see HOTGUN_HW), so the conversions between the pulses replay the reading of the next pulse.
+ * Usage: hg_replay [-v] [-e eeprom.bin] trace.txt
+ *   -v   print the controller status once per second of the virtual time
+ *   -e   the EEPROM content of the unit the trace was recorded on
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "sketch.h"
+#include "trace.h"
+
+struct EVENT {
+    char        type;
+    uint32_t    time;
+    uint16_t    value;
+};
+
+static uint16_t adc_burst   = 0;                                            // The 12-bit reading of the burst being converted
+static uint8_t  adc_conv    = 0;                                            // The conversions of the burst so far
+
+// The 16 10-bit conversions of the burst: the summ is the recorded reading multiplied by 4
+static uint16_t adcReplay(void *ctx, uint8_t pin) {
+    (void)ctx; (void)pin;
+    uint16_t summ = adc_burst << 2;
+    uint16_t v    = summ >> 4;
+    if (adc_conv < (summ & 0xF)) ++v;
+    ++adc_conv;
+    return v;
+}
+
+static void nextBurst(uint16_t reading) {
+    adc_burst   = reading;
+    adc_conv    = 0;
+}
+
+static bool loadTrace(const char *path, std::vector<EVENT> &events) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[128];
+    uint32_t lost = 0;
+    while (fgets(line, sizeof(line), f)) {
+        EVENT e;
+        unsigned long t;
+        unsigned v;
+        if (line[0] != '#' || sscanf(line + 1, "%c %lu %u", &e.type, &t, &v) != 3) continue;
+        if (e.type == EVENT_TRACE::EV_LOST) {
+            lost += v;
+            continue;
+        }
+        e.time  = t;
+        e.value = v;
+        events.push_back(e);
+    }
+    fclose(f);
+    if (lost)
+        fprintf(stderr, "Warning: %u events were lost while recording, the replay can differ from the original\n", lost);
+    return true;
+}
+
+static void report(void) {
+    printf("%8.3f s |%s|%s| temp %4d, power %2d%%, fan %4d\n", vboard.now() * 1e-6, vboard.lcdLine(0), vboard.lcdLine(1),
+        hg.averageTemp(), hg.appliedPower(), hg.fanSpeed());
+}
+
+static void runUntil(uint64_t t, bool verbose) {
+    while (vboard.now() < t) {
+        loop();
+        uint64_t step = t - vboard.now();
+        if (step > sketch_loop_us) step = sketch_loop_us;
+        uint64_t second = vboard.now() / 1000000;
+        vboard.advance(uint32_t(step));
+        if (verbose && vboard.now() / 1000000 != second)
+            report();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "ve:")) != -1) {
+        switch (opt) {
+            case 'v':
+                verbose = true;
+                break;
+            case 'e':
+                if (!vboard.eepromFile(optarg)) {
+                    fprintf(stderr, "Cannot open EEPROM file %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-v] [-e eeprom.bin] trace.txt\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-v] [-e eeprom.bin] trace.txt\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<EVENT> events;
+    if (!loadTrace(argv[optind], events)) {
+        fprintf(stderr, "Cannot read the trace file %s\n", argv[optind]);
+        return 1;
+    }
+
+    std::vector<int32_t> next_adc(events.size(), -1);                       // The reading recorded with the next sync pulse
+    int32_t adc = -1;
+    for (size_t i = events.size(); i-- > 0; ) {
+        if (events[i].type == EVENT_TRACE::EV_SYNC) {
+            next_adc[i] = adc;
+            adc = (i + 1 < events.size() && events[i+1].type == EVENT_TRACE::EV_ADC)?events[i+1].value:-1;
+        }
+    }
+
+    vboard.adcSource(adcReplay, 0);
+    for (size_t i = 0; i < events.size(); ++i) {                            // The initial reed switch level
+        if (events[i].type == EVENT_TRACE::EV_REED) {
+            vboard.setInput(sketch_pins.reed, events[i].value);
+            break;
+        }
+    }
+    setup();                                                                // No AC sync pulses but the recorded ones
+    for (size_t i = 0; i < events.size(); ++i) {
+        const EVENT &e = events[i];
+        runUntil(e.time, verbose);
+        switch (e.type) {
+            case EVENT_TRACE::EV_SYNC:
+                if (next_adc[i] >= 0) nextBurst(next_adc[i]);              // The burst started by this pulse
+                if (i + 1 < events.size() && events[i+1].type == EVENT_TRACE::EV_ADC)
+                    ++i;                                                    // The reading is recorded inside the sync ISR
+                vboard.setInput(sketch_pins.ac_sync, HIGH);
+                vboard.setInput(sketch_pins.ac_sync, LOW);
+                break;
+            case EVENT_TRACE::EV_ADC:
+                break;
+            case EVENT_TRACE::EV_ENCODER:
+                vboard.setInput(sketch_pins.enc_secd, (e.value & 2)?HIGH:LOW);
+                vboard.setInput(sketch_pins.enc_main, (e.value & 1)?HIGH:LOW);
+                break;
+            case EVENT_TRACE::EV_BUTTON:
+                vboard.setInput(sketch_pins.enc_button, e.value?HIGH:LOW);
+                break;
+            case EVENT_TRACE::EV_REED:
+                vboard.setInput(sketch_pins.reed, e.value?HIGH:LOW);
+                break;
+            default:
+                break;
+        }
+    }
+    loop();                                                                 // Let the firmware react to the last event
+    printf("Replayed %u events, %.3f s\n", (unsigned)events.size(), vboard.now() * 1e-6);
+    report();
+    return 0;
+}
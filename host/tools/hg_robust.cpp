@@ -0,0 +1,240 @@
+/*
+ * Monte Carlo robustness report of the Hot Air Gun temperature controller.
+ * Thousands of plant variants (see plant.h) with the parameters spread as the units of the fleet differ are
+ * simulated with the same firmware PID coefficients. Every variant runs the cold start to 300 Celsius,
+ * the step to 400 Celsius and the fan speed jump; the percentiles of the settling time, overshoot, ripple
+ * and the number of the over heating (chill) trips are reported.
+ * The air temperature target of every variant is the one its sensor reads as the preset temperature.
+ * Usage: hg_robust [-n variants] [-s seed] [-j threads] [-p Kp,Ki,Kd] [-c]
+ *   -n   the number of the plant variants (1000 by default)
+ *   -s   the random seed of the variants
+ *   -j   the number of threads (the number of CPU cores by default)
+ *   -p   the fixed PID coefficients instead of the gain schedule (see pid_schedule in gun.h)
+ *   -c   print every variant as CSV instead of the report
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include "gun_sim.h"
+#include "pool.h"
+
+// The spread of the plant parameters: uniform in [nominal - spread, nominal + spread]
+struct SPREAD {
+    double      heater_power;                                               // Relative, heater wattage
+    double      mains_voltage;                                              // Relative, mains voltage
+    double      heat_capacity;                                              // Relative, the heater and the nozzle mass
+    double      loss_fan;                                                   // Relative, the nozzle size (air flow)
+    double      dead_time;                                                  // s
+    double      sensor_tau;                                                 // s
+    double      sensor_gain;                                                // Relative, thermocouple & amplifier gain
+    double      ambient;                                                    // Celsius
+};
+
+static const SPREAD spread = { 0.15, 0.10, 0.20, 0.30, 0.25, 0.5, 0.10, 10.0 };
+
+const uint16_t  robust_temp         = 300;                                  // The preset temperature of the cold start, Celsius
+const uint16_t  robust_step_temp    = 400;                                  // The preset temperature after the step
+const uint16_t  robust_fan          = 1200;
+const uint16_t  robust_step_fan     = 1999;
+const double    robust_cold_time    = 180.0;                                // s
+const double    robust_step_time    = 120.0;
+const double    robust_fan_time     = 120.0;
+
+struct VARIANT {
+    PLANT_PARAMS    p;
+    double          cold_settling, cold_overshoot;                          // The cold start figures
+    double          step_settling, step_overshoot;                          // The setpoint step figures
+    double          fan_settling,  fan_deviation;                           // The fan speed jump figures
+    double          ripple;                                                 // At the end of the run
+    uint16_t        chill_trips;
+};
+
+struct RUN {
+    std::vector<VARIANT>    variants;
+    uint32_t                seed;
+    int                     pid[3];
+};
+
+struct CHILL {
+    bool        active;
+    uint16_t    trips;
+};
+
+static void chillCB(void *ctx, GUN_SIM *sim) {
+    CHILL *c = (CHILL *)ctx;
+    bool chill = sim->gun().isChill();
+    if (chill && !c->active) ++c->trips;
+    c->active = chill;
+}
+
+static double uniform(uint64_t &rnd, double nominal, double deviation) {
+    rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;                   // xorshift64
+    double u = double(rnd >> 11) / double(1ULL << 53);                      // [0, 1)
+    return nominal + deviation * (2.0 * u - 1.0);
+}
+
+static PLANT_PARAMS randomPlant(uint32_t seed, size_t index) {
+    uint64_t rnd = 0x9E3779B97F4A7C15ULL * (index + 1) ^ seed;
+    for (uint8_t i = 0; i < 4; ++i) uniform(rnd, 0, 0);                    // Mix the state
+    PLANT_PARAMS p      = plant_nominal;
+    p.heater_power      = uniform(rnd, p.heater_power,  p.heater_power  * spread.heater_power);
+    p.mains_voltage     = uniform(rnd, p.mains_voltage, p.mains_voltage * spread.mains_voltage);
+    p.heat_capacity     = uniform(rnd, p.heat_capacity, p.heat_capacity * spread.heat_capacity);
+    p.loss_fan          = uniform(rnd, p.loss_fan,      p.loss_fan      * spread.loss_fan);
+    p.dead_time         = uniform(rnd, p.dead_time,     spread.dead_time);
+    p.sensor_tau        = uniform(rnd, p.sensor_tau,    spread.sensor_tau);
+    p.sensor_gain       = uniform(rnd, p.sensor_gain,   p.sensor_gain   * spread.sensor_gain);
+    p.ambient           = uniform(rnd, p.ambient,       spread.ambient);
+    return p;
+}
+
+// The air temperature the sensor of the variant reads as the nominal one
+static double trueTemp(const PLANT_PARAMS &p, double celsius) {
+    double adc = PLANT::adcValue(celsius);
+    double lo = 0.0, hi = 1000.0;
+    for (uint8_t i = 0; i < 40; ++i) {
+        double mid = (lo + hi) / 2;
+        if (PLANT::adcValue(mid, p.sensor_gain) < adc) lo = mid; else hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+static void runVariant(void *ctx, size_t index) {
+    RUN     *r  = (RUN *)ctx;
+    VARIANT &v  = r->variants[index];
+    v.p = randomPlant(r->seed, index);
+
+    GUN_SIM     sim(v.p, uint32_t(index + 1));
+    RESPONSE    resp;
+    CHILL       chill = { false, 0 };
+    sim.init();
+    for (uint8_t i = 0; i < 3; ++i)
+        if (r->pid[i] >= 0) sim.gun().changePID(i+1, r->pid[i]);
+    sim.onPeriod(chillCB, &chill);
+    sim.setFan(robust_fan);
+    sim.setTemp(robust_temp);
+    sim.powerOn(true);
+
+    double target = trueTemp(v.p, robust_temp);
+    resp.start(sim.time(), sim.plant().airTemp(), target);
+    sim.run(robust_cold_time, &resp);
+    RESPONSE_STAT s = resp.result();
+    v.cold_settling     = s.settling;
+    v.cold_overshoot    = s.overshoot;
+
+    double step_target = trueTemp(v.p, robust_step_temp);
+    sim.setTemp(robust_step_temp);
+    resp.start(sim.time(), target, step_target);
+    sim.run(robust_step_time, &resp);
+    s = resp.result();
+    v.step_settling     = s.settling;
+    v.step_overshoot    = s.overshoot;
+
+    sim.setFan(robust_step_fan);
+    resp.start(sim.time(), step_target, step_target);
+    sim.run(robust_fan_time, &resp);
+    s = resp.result();
+    v.fan_settling      = s.settling;
+    v.fan_deviation     = s.overshoot;
+    v.ripple            = s.ripple;
+    v.chill_trips       = chill.trips;
+}
+
+// Print the percentiles of the figure; the negative values (not settled) are counted separately
+static void report(const char *name, const char *units, std::vector<double> values) {
+    size_t total = values.size();
+    values.erase(std::remove_if(values.begin(), values.end(), [](double x){ return x < 0; }), values.end());
+    std::sort(values.begin(), values.end());
+    printf("%-20s %-3s", name, units);
+    if (values.empty()) {
+        printf(" %8s %8s %8s %8s %8s", "-", "-", "-", "-", "-");
+    } else {
+        const double pcnt[] = { 0.5, 0.9, 0.95, 0.99 };
+        for (uint8_t i = 0; i < 4; ++i)
+            printf(" %8.2f", values[size_t(pcnt[i] * (values.size() - 1) + 0.5)]);
+        printf(" %8.2f", values.back());
+    }
+    if (values.size() != total)
+        printf("   not settled %u (%.1f%%)", unsigned(total - values.size()), 100.0 * (total - values.size()) / total);
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    RUN         r;
+    size_t      n       = 1000;
+    unsigned    threads = 0;
+    bool        csv     = false;
+    r.seed  = 1;
+    r.pid[0] = r.pid[1] = r.pid[2] = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:j:p:c")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atol(optarg);
+                break;
+            case 's':
+                r.seed = atol(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'p':
+                if (sscanf(optarg, "%d,%d,%d", &r.pid[0], &r.pid[1], &r.pid[2]) != 3) {
+                    fprintf(stderr, "Wrong PID coefficients: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                csv = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n variants] [-s seed] [-j threads] [-p Kp,Ki,Kd] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (n == 0) return 0;
+
+    r.variants.resize(n);
+    THREAD_POOL pool(threads);
+    pool.run(runVariant, &r, n);
+
+    if (csv) {
+        printf("heater_W,mains,capacity_JK,loss_fan_WK,dead_time_s,sensor_tau_s,sensor_gain,ambient_C,");
+        printf("cold_settling_s,cold_overshoot_C,step_settling_s,step_overshoot_C,fan_settling_s,fan_deviation_C,ripple_C,chill_trips\n");
+        for (size_t i = 0; i < n; ++i) {
+            const VARIANT &v = r.variants[i];
+            printf("%.1f,%.3f,%.2f,%.3f,%.3f,%.3f,%.3f,%.1f,", v.p.heater_power, v.p.mains_voltage, v.p.heat_capacity,
+                v.p.loss_fan, v.p.dead_time, v.p.sensor_tau, v.p.sensor_gain, v.p.ambient);
+            printf("%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%u\n", v.cold_settling, v.cold_overshoot, v.step_settling,
+                v.step_overshoot, v.fan_settling, v.fan_deviation, v.ripple, v.chill_trips);
+        }
+        return 0;
+    }
+
+    std::vector<double> cold_s, cold_o, step_s, step_o, fan_s, fan_d, ripple, trips;
+    uint32_t tripped = 0, total_trips = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const VARIANT &v = r.variants[i];
+        cold_s.push_back(v.cold_settling);  cold_o.push_back(v.cold_overshoot);
+        step_s.push_back(v.step_settling);  step_o.push_back(v.step_overshoot);
+        fan_s.push_back(v.fan_settling);    fan_d.push_back(v.fan_deviation);
+        ripple.push_back(v.ripple);         trips.push_back(v.chill_trips);
+        if (v.chill_trips) ++tripped;
+        total_trips += v.chill_trips;
+    }
+    printf("%u plant variants, %u threads\n", unsigned(n), pool.size());
+    printf("%-24s %8s %8s %8s %8s %8s\n", "", "p50", "p90", "p95", "p99", "max");
+    report("cold start settling",   "s",    cold_s);
+    report("cold start overshoot",  "C",    cold_o);
+    report("step settling",         "s",    step_s);
+    report("step overshoot",        "C",    step_o);
+    report("fan jump settling",     "s",    fan_s);
+    report("fan jump deviation",    "C",    fan_d);
+    report("ripple",                "C",    ripple);
+    report("chill trips",           "",     trips);
+    printf("Units with chill trips: %u (%.1f%%), total trips %u\n", tripped, 100.0 * tripped / n, total_trips);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Stress test of the data shared by the interrupt handlers and loop() under the emulated preemption.
+ * The reader runs single-stepped and the writer "interrupt" is injected between its instructions (see preempt.h).
+ * The AVR reads the multi-byte values byte by byte, the test value WIDE is copied the same way, so the plain copy
+ * of it tears when the interrupt comes in the middle. The SNAPSHOT copy (see snapshot.h) and the temperature
+ * history (HIST, updated by the AC sync interrupt) must always be consistent: the result of every HIST reader
+ * must be the one of the history state before or after some interrupt that came during the call.
+ * Usage: hg_stress_isr [-n calls] [-r rate] [-s seed]
+ *   -n   the reader calls per test (2000 by default)
+ *   -r   the average number of the reader instructions between the interrupts (8 by default)
+ *   -s   the seed of the interrupt points
+ * The exit code is not zero if SNAPSHOT or HIST returned the inconsistent data.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+#include "snapshot.h"
+#include "stat.h"
+#include "preempt.h"
+
+// The 8-byte value copied byte by byte as the 8-bit MCU does; the high half is the inverted low half
+struct WIDE {
+    uint8_t     b[8];
+    WIDE(void) : b()                                                        { }
+    WIDE(uint32_t n)                                                        { for (uint8_t i = 0; i < 4; ++i) { b[i] = n >> (8*i); b[i+4] = ~b[i]; } }
+    WIDE(const volatile WIDE &w)                                            { for (uint8_t i = 0; i < 8; ++i) b[i] = w.b[i]; }
+    void        operator=(const WIDE &w) volatile                           { for (uint8_t i = 0; i < 8; ++i) b[i] = w.b[i]; }
+    void        operator=(const volatile WIDE &w)                           { for (uint8_t i = 0; i < 8; ++i) b[i] = w.b[i]; }
+    bool        valid(void) const {
+        for (uint8_t i = 0; i < 4; ++i)
+            if (b[i+4] != uint8_t(~b[i])) return false;
+        return true;
+    }
+};
+
+const uint32_t  hist_updates    = 1 << 18;                                  // The length of the history input sequence
+
+struct HIST_REF {                                                           // The history results after the number of updates
+    int32_t     read;
+    uint32_t    dispersion;
+    int32_t     last;
+};
+
+struct CTX {                                                                // In the memory shared with the traced process
+    volatile uint32_t   interrupts;
+    uint32_t            calls;
+    uint32_t            errors;
+    uint32_t            n;                                                  // The WIDE counter of the writer
+    volatile WIDE       plain;
+    SNAPSHOT<WIDE>      snap;
+    HIST<int16_t>       hist;
+    volatile uint32_t   updates;                                            // The number of the history updates so far
+    int16_t             input[hist_updates];
+    HIST_REF            ref[hist_updates + 1];
+};
+
+static void wideWriter(void *p) {
+    CTX *c = (CTX *)p;
+    ++c->interrupts;
+    WIDE w(++c->n);
+    c->plain = w;
+    c->snap.write(w);
+}
+
+static void plainReader(void *p) {
+    CTX *c = (CTX *)p;
+    WIDE w(c->plain);
+    ++c->calls;
+    if (!w.valid()) ++c->errors;
+}
+
+static void snapshotReader(void *p) {
+    CTX *c = (CTX *)p;
+    WIDE w = c->snap.read();
+    ++c->calls;
+    if (!w.valid()) ++c->errors;
+}
+
+static void histWriter(void *p) {
+    CTX *c = (CTX *)p;
+    ++c->interrupts;
+    if (c->updates >= hist_updates) return;
+    c->hist.update(c->input[c->updates]);
+    c->updates = c->updates + 1;
+}
+
+// The result should match the history state at some moment of the call
+static void histReader(void *p) {
+    CTX *c = (CTX *)p;
+    uint32_t    from    = c->updates;
+    int32_t     r       = c->hist.read();
+    uint32_t    d       = c->hist.dispersion();
+    int32_t     l       = c->hist.last();
+    uint32_t    to      = c->updates;
+    bool        r_ok = false, d_ok = false, l_ok = false;
+    for (uint32_t u = from; u <= to; ++u) {
+        r_ok |= (c->ref[u].read == r);
+        d_ok |= (c->ref[u].dispersion == d);
+        l_ok |= (c->ref[u].last == l);
+    }
+    ++c->calls;
+    if (!r_ok || !d_ok || !l_ok) ++c->errors;
+}
+
+static void prepare(CTX *c, uint32_t seed) {
+    uint32_t rnd = seed * 2654435761u + 1;
+    HIST<int16_t> h;
+    c->ref[0] = { h.read(), h.dispersion(), h.last() };
+    for (uint32_t i = 0; i < hist_updates; ++i) {
+        rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+        c->input[i] = rnd % 4096;                                           // The 12-bit temperature
+        h.update(c->input[i]);
+        c->ref[i+1] = { h.read(), h.dispersion(), h.last() };
+    }
+}
+
+struct TEST {
+    const char*     name;
+    PREEMPT::FUNC   reader;
+    PREEMPT::FUNC   writer;
+    bool            must_pass;                                              // The plain copy is expected to tear
+};
+
+static const TEST tests[] = {
+    { "plain copy",         plainReader,    wideWriter, false   },
+    { "SNAPSHOT::read",     snapshotReader, wideWriter, true    },
+    { "HIST readers",       histReader,     histWriter, true    }
+};
+
+int main(int argc, char *argv[]) {
+    uint32_t    calls   = 2000;
+    uint16_t    rate    = 8;
+    uint32_t    seed    = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                calls = atol(optarg);
+                break;
+            case 'r':
+                rate = atoi(optarg);
+                break;
+            case 's':
+                seed = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n calls] [-r rate] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (rate == 0) rate = 1;
+
+    void *mem = PREEMPT::shared(sizeof(CTX));
+    if (!mem) {
+        fprintf(stderr, "Cannot allocate the shared memory\n");
+        return 1;
+    }
+    CTX *c = new (mem) CTX;
+    prepare(c, seed);
+    bool failed = false;
+    printf("%-20s %10s %10s %10s\n", "test", "calls", "interrupts", "torn");
+    for (const TEST &t : tests) {
+        c->interrupts = c->calls = c->errors = c->n = 0;
+        c->plain = WIDE(0);
+        c->snap.write(WIDE(0));
+        c->hist.reset();
+        c->updates = 0;
+        if (!PREEMPT::run(t.reader, t.writer, c, calls, rate, seed)) {
+            fprintf(stderr, "Cannot trace the test process\n");
+            return 1;
+        }
+        printf("%-20s %10u %10u %10u%s\n", t.name, c->calls, c->interrupts, c->errors,
+            (t.must_pass && c->errors)?"   FAILED":"");
+        if (t.must_pass && c->errors) failed = true;
+    }
+    PREEMPT::release(c, sizeof(CTX));
+    return failed?1:0;
+}
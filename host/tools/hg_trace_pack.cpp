@@ -0,0 +1,189 @@
+/*
+ * Pack the controller telemetry to the binary trace file (see hgtrace.h).
+ * The serial port captures of the firmware built with TELEMETRY_BINARY (see telemetry.h) are decoded: the binary
+ * frames are found in the stream by the sync bytes and checked by the checksum, the text lines are skipped.
+ * A new session starts with every capture file, when the controller restarts (millis() goes back)
+ * or when the stream was interrupted for a while.
+ * Instead of the captures, the sessions can be generated by the closed loop simulation (see gun_sim.h)
+ * with random preset temperature and fan speed to try the analyzer on a big trace.
+ * Usage: hg_trace_pack -o trace.hgt capture ...
+ *        hg_trace_pack -o trace.hgt -g sessions [-r period] [-s seed]
+ *   -o   the trace file to write
+ *   -g   generate the sessions by the simulation
+ *   -r   the sampling period of the generated sessions, ms (100 by default)
+ *   -s   the random seed of the generated sessions
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hgtrace.h"
+#include "telemetry.h"
+#include "gun_sim.h"
+
+const uint32_t  pack_session_gap    = 10000;                                // The stream interruption to start the new session, ms
+const uint32_t  pack_period         = 1100;                                 // pidSCREEN::period
+
+static uint32_t trace_time  = 0;                                            // The time of the last record, ms
+
+static uint16_t le16(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+
+static bool packCapture(const char *path, HGT_WRITER &w, uint32_t &bad) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t     frame[tlm_frame_len];
+    uint8_t     len         = 0;
+    bool        first       = true;
+    uint32_t    last_ms     = 0;
+    uint32_t    base        = 0;                                            // The trace time of the session start minus its millis()
+    int c;
+    w.newSession();
+    while ((c = fgetc(f)) != EOF) {
+        if (len == 0 && c != tlm_sync0) continue;
+        if (len == 1 && c != tlm_sync1) {
+            len = (c == tlm_sync0)?1:0;
+            continue;
+        }
+        frame[len++] = uint8_t(c);
+        if (len < tlm_frame_len) continue;
+        len = 0;
+        uint8_t summ = 0;
+        for (uint8_t i = 2; i < 2 + tlm_data_len; ++i)
+            summ += frame[i];
+        if (summ != frame[tlm_frame_len-1]) {                               // Not a frame, perhaps the text
+            ++bad;
+            continue;
+        }
+        uint32_t ms = uint32_t(le16(frame+2)) | (uint32_t(le16(frame+4)) << 16);
+        if (first || ms < last_ms || ms - last_ms > pack_session_gap) {
+            if (!first) w.newSession();
+            base    = (w.records()?trace_time + pack_period:0) - ms;
+            first   = false;
+        }
+        last_ms = ms;
+        HGT_RECORD r;
+        memset(&r, 0, sizeof(r));
+        r.time      = base + ms;
+        r.temp      = le16(frame+6);
+        r.temp_set  = le16(frame+8);
+        r.fan       = le16(frame+10);
+        r.power     = frame[12];
+        r.mode      = frame[13];
+        w.add(r);
+        trace_time  = r.time;
+    }
+    fclose(f);
+    return true;
+}
+
+static uint32_t rnd_state = 1;
+static uint32_t randomIn(uint32_t from, uint32_t to) {
+    rnd_state ^= rnd_state << 13; rnd_state ^= rnd_state >> 17; rnd_state ^= rnd_state << 5;   // xorshift32
+    return from + rnd_state % (to - from + 1);
+}
+
+static void sampleGun(GUN_SIM &sim, uint32_t base, HGT_WRITER &w) {
+    HOTGUN &hg = sim.gun();
+    HGT_RECORD r;
+    memset(&r, 0, sizeof(r));
+    r.time      = base + uint32_t(sim.time() * 1000 + 0.5);
+    r.temp      = hg.getCurrTemp();
+    r.temp_set  = hg.presetTemp();
+    r.fan       = hg.fanSpeed();
+    r.power     = hg.averagePower();
+    r.mode      = hg.powerMode();
+    w.add(r);
+    trace_time  = r.time;
+}
+
+static void runGun(GUN_SIM &sim, double seconds, uint32_t period, uint32_t base, HGT_WRITER &w) {
+    for (double t = 0; t < seconds; t += period * 1e-3) {
+        sim.run(period * 1e-3);
+        sampleGun(sim, base, w);
+    }
+}
+
+// Lift the gun, change the preset temperature a few times, then put it back and let it cool down
+static void generateSession(uint32_t period, HGT_WRITER &w) {
+    GUN_SIM sim(plant_nominal, rnd_state);
+    sim.init();
+    uint32_t base = trace_time + pack_period;
+    w.newSession();
+    sim.setFan(randomIn(800, 1999));
+    sim.setTemp(randomIn(150, 450));
+    sim.powerOn(true);
+    uint8_t steps = randomIn(1, 4);
+    for (uint8_t i = 0; i < steps; ++i) {
+        runGun(sim, randomIn(60, 240), period, base, w);
+        sim.setTemp(randomIn(150, 450));
+        if (randomIn(0, 1)) sim.setFan(randomIn(800, 1999));
+    }
+    runGun(sim, randomIn(60, 240), period, base, w);
+    sim.powerOn(false);
+    for (uint16_t s = 0; s < 600 && sim.gun().powerMode() != HOTGUN::POWER_OFF; ++s)
+        runGun(sim, 1, period, base, w);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s -o trace.hgt capture ...\n", name);
+    fprintf(stderr, "       %s -o trace.hgt -g sessions [-r period] [-s seed]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char* out         = 0;
+    uint32_t    sessions    = 0;
+    uint32_t    period      = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:g:r:s:")) != -1) {
+        switch (opt) {
+            case 'o':
+                out = optarg;
+                break;
+            case 'g':
+                sessions = atol(optarg);
+                break;
+            case 'r':
+                period = atol(optarg);
+                if (period < 10) period = 10;
+                break;
+            case 's':
+                rnd_state = atol(optarg);
+                if (rnd_state == 0) rnd_state = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (!out || (sessions == 0 && optind >= argc)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    HGT_WRITER w;
+    if (!w.open(out, sessions?period:pack_period)) {
+        fprintf(stderr, "Cannot create the trace file %s\n", out);
+        return 1;
+    }
+    uint32_t bad = 0;
+    if (sessions) {
+        for (uint32_t s = 0; s < sessions; ++s)
+            generateSession(period, w);
+    } else {
+        for (int i = optind; i < argc; ++i) {
+            if (!packCapture(argv[i], w, bad)) {
+                fprintf(stderr, "Cannot read the capture file %s\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+    uint64_t records = w.records();
+    if (!w.close()) {
+        fprintf(stderr, "Cannot write the trace file %s\n", out);
+        return 1;
+    }
+    printf("%llu records written to %s", (unsigned long long)records, out);
+    if (bad) printf(", %u broken frames skipped", bad);
+    printf("\n");
+    return 0;
+}
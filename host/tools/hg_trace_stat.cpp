@@ -0,0 +1,204 @@
+/*
+ * Analyze the binary trace files of the controller telemetry (see hgtrace.h).
+ * The files are memory-mapped, the sessions are located by the index and analyzed in parallel on all CPU cores.
+ * Per session: the duration, the working time, the settling time after every preset temperature change,
+ * the average power (duty) while working and the energy supplied to the heater.
+ * Usage: hg_trace_stat [-b band] [-w watts] [-j threads] [-q] trace.hgt ...
+ *   -b   the settling band, internal units (5 by default, see workSCREEN::show())
+ *   -w   the heater power, W, to calculate the energy (600 by default)
+ *   -j   the number of threads (the number of CPU cores by default)
+ *   -q   print the totals only
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+#include "hgtrace.h"
+#include "pool.h"
+
+const uint32_t  stat_max_gap        = 5000;                                 // The longer gap between the records is not counted, ms
+const uint8_t   mode_on             = 1;                                    // HOTGUN::POWER_ON
+const uint8_t   mode_fixed          = 2;                                    // HOTGUN::POWER_FIXED
+
+struct SESSION_STAT {
+    uint32_t    start;                                                      // The session start time, ms
+    uint64_t    records;
+    double      duration;                                                   // s
+    double      working;                                                    // The time in POWER_ON or POWER_FIXED mode, s
+    double      duty;                                                       // The average power while working, %
+    double      energy;                                                     // kJ
+    uint32_t    steps;                                                      // The number of the preset temperature changes
+    uint32_t    unsettled;                                                  // The steps have not settled
+    double      settling;                                                   // The average settling time of the settled steps, s
+    double      settling_max;                                               // s
+};
+
+struct SESSION_REF {
+    const HGT_RECORD*   first;
+    uint64_t            records;
+};
+
+struct JOB {
+    std::vector<SESSION_REF>    sessions;
+    std::vector<SESSION_STAT>   stat;
+    uint16_t                    band;
+    double                      watts;
+};
+
+// The step is settled when the temperature gets in the band around the preset one and remains there till the next step
+static void closeStep(SESSION_STAT &s, bool open, int64_t in_band_since, uint32_t step_time) {
+    if (!open) return;
+    ++s.steps;
+    if (in_band_since < 0) {
+        ++s.unsettled;
+        return;
+    }
+    double t = (in_band_since - step_time) * 1e-3;
+    s.settling += t;
+    if (t > s.settling_max) s.settling_max = t;
+}
+
+static void analyze(void *ctx, size_t index) {
+    JOB *job = (JOB *)ctx;
+    const SESSION_REF &ref  = job->sessions[index];
+    SESSION_STAT      &s    = job->stat[index];
+    const HGT_RECORD  *r    = ref.first;
+    s = SESSION_STAT { r[0].time, ref.records, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    double      power_ms    = 0;                                            // Sum of power * ms while working
+    bool        step        = false;                                        // The preset temperature step is watched
+    uint32_t    step_time   = 0;
+    int64_t     in_band     = -1;                                           // The time the temperature entered the band
+    for (uint64_t i = 0; i < ref.records; ++i) {
+        const HGT_RECORD &c = r[i];
+        bool working = (c.mode == mode_on);
+        if (working && (!step || c.temp_set != r[i-1].temp_set)) {          // The new step starts
+            closeStep(s, step, in_band, step_time);
+            step        = true;
+            step_time   = c.time;
+            in_band     = -1;
+        } else if (!working && step) {
+            closeStep(s, step, in_band, step_time);
+            step = false;
+        }
+        if (step) {
+            int diff = int(c.temp) - int(c.temp_set);
+            if (diff < -int(job->band) || diff > int(job->band))
+                in_band = -1;
+            else if (in_band < 0)
+                in_band = c.time;
+        }
+        if (i + 1 < ref.records) {
+            uint32_t dt = r[i+1].time - c.time;
+            if (dt > stat_max_gap) continue;
+            s.energy += c.power * dt;
+            if (c.mode == mode_on || c.mode == mode_fixed) {
+                s.working   += dt;
+                power_ms    += c.power * dt;
+            }
+        }
+    }
+    closeStep(s, step, in_band, step_time);
+    s.duration  = (r[ref.records-1].time - r[0].time) * 1e-3;
+    s.duty      = (s.working > 0)?power_ms / s.working:0;
+    s.working  *= 1e-3;
+    s.energy   *= job->watts * 1e-2 * 1e-3 * 1e-3;                          // % * W * ms -> kJ
+    if (s.steps > s.unsettled) s.settling /= (s.steps - s.unsettled);
+}
+
+int main(int argc, char *argv[]) {
+    JOB         job;
+    unsigned    threads = 0;
+    bool        quiet   = false;
+    job.band    = 5;
+    job.watts   = 600;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:w:j:q")) != -1) {
+        switch (opt) {
+            case 'b':
+                job.band = atoi(optarg);
+                break;
+            case 'w':
+                job.watts = atof(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-b band] [-w watts] [-j threads] [-q] trace.hgt ...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-b band] [-w watts] [-j threads] [-q] trace.hgt ...\n", argv[0]);
+        return 1;
+    }
+
+    THREAD_POOL pool(threads);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t    bytes = 0, records = 0;
+    SESSION_STAT total = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    double      power_s = 0, settling = 0;
+    uint32_t    sessions = 0;
+    for (int f = optind; f < argc; ++f) {
+        HGT_FILE    trace;
+        if (!trace.open(argv[f])) {
+            fprintf(stderr, "%s\n", trace.error());
+            return 1;
+        }
+        const HGT_HEADER &h     = trace.header();
+        const HGT_INDEX  *idx   = trace.index();
+        job.sessions.clear();
+        for (uint64_t i = 0; i < h.index_entries; ++i) {                    // Locate the sessions by the index
+            if (idx[i].kind != HGT_SESSION || idx[i].record >= h.records) continue;
+            if (!job.sessions.empty())
+                job.sessions.back().records = idx[i].record - (job.sessions.back().first - trace.records());
+            SESSION_REF ref = { trace.records() + idx[i].record, 0 };
+            job.sessions.push_back(ref);
+        }
+        if (!job.sessions.empty())
+            job.sessions.back().records = h.records - (job.sessions.back().first - trace.records());
+        for (size_t i = job.sessions.size(); i-- > 0; )
+            if (job.sessions[i].records == 0) job.sessions.erase(job.sessions.begin() + i);
+        job.stat.resize(job.sessions.size());
+        pool.run(analyze, &job, job.sessions.size());
+
+        if (!quiet) {
+            printf("%s: %llu records, %u sessions\n", argv[f], (unsigned long long)h.records, (unsigned)job.sessions.size());
+            printf("%8s %10s %9s %9s %7s %9s %6s %9s %9s %9s\n", "session", "start,s", "length,s", "work,s",
+                "duty,%", "energy,kJ", "steps", "unsettled", "settle,s", "worst,s");
+        }
+        for (size_t i = 0; i < job.stat.size(); ++i) {
+            const SESSION_STAT &s = job.stat[i];
+            if (!quiet)
+                printf("%8u %10.1f %9.1f %9.1f %7.1f %9.2f %6u %9u %9.1f %9.1f\n", unsigned(sessions + i), s.start * 1e-3,
+                    s.duration, s.working, s.duty, s.energy, s.steps, s.unsettled, s.settling, s.settling_max);
+            total.duration  += s.duration;
+            total.working   += s.working;
+            total.energy    += s.energy;
+            total.steps     += s.steps;
+            total.unsettled += s.unsettled;
+            power_s         += s.duty * s.working;
+            settling        += s.settling * (s.steps - s.unsettled);
+            if (s.settling_max > total.settling_max) total.settling_max = s.settling_max;
+        }
+        sessions    += job.stat.size();
+        records     += h.records;
+        bytes       += trace.bytes();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    printf("Total: %u sessions, %.1f h, working %.1f h, duty %.1f%%, energy %.1f kJ\n", sessions, total.duration / 3600,
+        total.working / 3600, (total.working > 0)?power_s / total.working:0, total.energy);
+    printf("Steps: %u, unsettled %u, settling average %.1f s, worst %.1f s\n", total.steps, total.unsettled,
+        (total.steps > total.unsettled)?settling / (total.steps - total.unsettled):0, total.settling_max);
+    printf("Analyzed %llu records (%.1f MB) in %.3f s, %.1f MB/s, %u threads\n", (unsigned long long)records,
+        bytes / 1048576.0, elapsed, (elapsed > 0)?bytes / 1048576.0 / elapsed:0, pool.size());
+    return 0;
+}
@@ -0,0 +1,487 @@
+/*
+ * PID coefficients search of the Hot Air Gun temperature controller on the simulated plant.
+ * Every candidate (Kp, Ki, Kd) is scored by the cold start to several preset temperatures at several fan speeds:
+ * the time to the 'ready' state as workSCREEN detects it plus the overshoot of the air temperature, weighted.
+ * When the temperature is stable, the preset temperature steps by 50 Celsius (down from the highest point:
+ * the calibration is extrapolated above it) and then the fan speed changes; both are scored
+ * by the settling time plus the weighted overshoot, so the coefficients are not fitted to the cold start alone.
+ * The coarse logarithmic grid is swept first, then the best candidate is refined by the pattern search.
+ * The candidates are simulated in parallel on all CPU cores.
+ * With -t the result is the PID gain schedule, the conditions are the schedule points (see temp_tip and gs_fan
+ * in vars.cpp). The search starts from the common coefficients of all conditions, then every point is refined in
+ * turn by its own cost plus the smoothness penalty: the squared log ratio of every coefficient to the ones of the
+ * neighbouring points, weighted. The point is scored through the whole schedule as the firmware runs it, so the step
+ * to the middle between the points runs on the coefficients interpolated with the neighbours. So the neighbouring points differ only as much as the plant needs, and the
+ * interpolated coefficients between them are sane. Every point is scored on the nominal plant and on the
+ * slow, fast and lagging plant variants, so the coefficients are not over-fitted to the single cold start.
+ * With -a the firmware relay auto-tune (see autotune.h) runs at every condition instead of the search,
+ * the coefficients it finds are scored the same way.
+ * Usage: hg_tune_pid [-j threads] [-g points] [-w weight] [-s weight] [-v] [-t | -a]
+ *   -j   the number of threads (the number of CPU cores by default)
+ *   -g   the grid points per coefficient (8 by default)
+ *   -w   the overshoot weight, s per Celsius (2 by default)
+ *   -s   the smoothness weight of the gain schedule, s per squared log ratio (10 by default)
+ *   -v   print every improvement of the refinement
+ *   -t   search the gain schedule
+ *   -a   score the relay auto-tune
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "gun_sim.h"
+#include "pool.h"
+#include "autotune.h"
+
+struct CONDITION {
+    uint16_t    temp;                                                       // The preset temperature, Celsius
+    uint16_t    fan;                                                        // The fan speed
+    uint16_t    new_fan;                                                    // The fan speed after the change
+    uint16_t    new_temp;                                                   // The preset temperature after the step
+};
+
+static const CONDITION conditions[] = {
+    { 200,  600, 1999, 250 }, { 200, 1200,  600, 250 }, { 200, 1999,  600, 250 },
+    { 300,  600, 1999, 350 }, { 300, 1200,  600, 350 }, { 300, 1999,  600, 350 },
+    { 400,  600, 1999, 350 }, { 400, 1200,  600, 350 }, { 400, 1999,  600, 350 }
+};
+const uint8_t   cond_num        = sizeof(conditions) / sizeof(conditions[0]);
+const double    cond_duration   = 240.0;                                    // Time to watch the cold start, s
+const double    change_duration = 120.0;                                    // Time to watch the fan change and the step, s
+const double    not_ready_cost  = 2 * cond_duration;                        // Cost of the candidate never been ready
+const double    not_settled_cost= cond_duration;                            // Additional cost of the oscillating temperature
+
+const int       k_min[3]        = { 8, 2,   0 };                            // The grid range of Kp, Ki, Kd
+const int       k_max[3]        = { 2048, 256, 2048 };
+
+struct GAINS {
+    int         k[3];                                                       // Kp, Ki, Kd; negative - the firmware gain schedule
+};
+
+struct SCORE {
+    double      cost;                                                       // The mean cost over the conditions, the less the better
+    double      ready;                                                      // The mean time to ready, s
+    double      ready_max;                                                  // The worst time to ready, s (negative if not ready)
+    double      overshoot;                                                  // The worst overshoot, Celsius
+    double      step;                                                       // The worst settling time after the step, s (negative if not settled)
+    double      fan_dev;                                                    // The worst deviation on the fan change, Celsius
+    uint8_t     failed;                                                     // The number of conditions never been ready
+};
+
+static double overshoot_weight = 2.0;
+static double smooth_weight    = 10.0;
+const uint8_t schedule_sweeps  = 3;                                         // The refinement rounds over the schedule points
+
+struct READY {
+    double      time;                                                       // The time the gun became ready, s
+};
+
+// The same check as in workSCREEN::show()
+static void readyCB(void *ctx, GUN_SIM *sim) {
+    READY *r = (READY *)ctx;
+    HOTGUN &hg = sim->gun();
+    if (r->time < 0 && hg.isReady())
+        r->time = sim->time();
+}
+
+// The cost of the response to the fan change or to the setpoint step: the settling time and the overshoot
+static double changeCost(const RESPONSE_STAT &r) {
+    double cost = overshoot_weight * r.overshoot;
+    cost += (r.settling < 0)?not_settled_cost:r.settling;
+    return cost;
+}
+
+// Score the coefficients by the conditions [first, first+count). With the gain schedule table the coefficients
+// replace the ones of the condition point and the gun runs the whole schedule
+static SCORE evaluate(const GAINS &g, uint8_t first = 0, uint8_t count = cond_num, const PLANT_PARAMS &p = plant_nominal,
+                      const GAINS *table = 0) {
+    SCORE s = { 0, 0, 0, 0, 0, 0, 0 };
+    for (uint8_t c = first; c < first + count; ++c) {
+        GUN_SIM     sim(p);
+        RESPONSE    resp;
+        READY       ready = { -1.0 };
+        PID_TABLE   schedule;
+        sim.init();
+        if (table) {
+            for (uint8_t n = 0; n < cond_num; ++n)
+                for (uint8_t k = 0; k < 3; ++k)
+                    schedule[n/3][n%3][k] = (n == c)?g.k[k]:table[n].k[k];
+            uint16_t gs_temp[3];
+            sim.config().scheduleTemp(gs_temp);
+            sim.gun().gainSchedule(&schedule, gs_temp);
+        } else {
+            for (uint8_t i = 0; i < 3 && g.k[0] >= 0; ++i)
+                sim.gun().changePID(i+1, g.k[i]);
+        }
+        sim.onPeriod(readyCB, &ready);
+        sim.setFan(conditions[c].fan);
+        sim.setTemp(conditions[c].temp);
+        sim.powerOn(true);
+        resp.start(0, sim.plant().airTemp(), conditions[c].temp);
+        sim.run(cond_duration, &resp);
+        RESPONSE_STAT r = resp.result();
+        double cost = overshoot_weight * r.overshoot;
+        if (ready.time < 0) {
+            cost += not_ready_cost;
+            ++s.failed;
+        } else {
+            cost += ready.time;
+            s.ready += ready.time;
+            if (ready.time > s.ready_max) s.ready_max = ready.time;
+        }
+        if (r.settling < 0) cost += not_settled_cost;
+        if (r.overshoot > s.overshoot) s.overshoot = r.overshoot;
+
+        uint16_t temp = conditions[c].new_temp;
+        sim.setTemp(temp);
+        resp.start(sim.time(), conditions[c].temp, temp);
+        sim.run(change_duration, &resp);
+        r = resp.result();
+        cost += changeCost(r);
+        if (s.step >= 0 && (r.settling < 0 || r.settling > s.step)) s.step = r.settling;
+
+        sim.setFan(conditions[c].new_fan);
+        resp.start(sim.time(), temp, temp);
+        sim.run(change_duration, &resp);
+        r = resp.result();
+        cost += changeCost(r);
+        if (r.overshoot > s.fan_dev) s.fan_dev = r.overshoot;
+        s.cost += cost;
+    }
+    s.cost /= count;
+    if (s.failed) s.ready_max = -1;
+    if (s.failed < count) s.ready /= (count - s.failed);
+    return s;
+}
+
+// The plant variants to score the gain schedule point: nominal, slow, fast and lagging
+static PLANT_PARAMS variant(uint8_t v) {
+    PLANT_PARAMS p = plant_nominal;
+    switch (v) {
+        case 1:
+            p.heater_power  *= 0.85;
+            p.heat_capacity *= 1.2;
+            break;
+        case 2:
+            p.heater_power  *= 1.15;
+            p.heat_capacity *= 0.8;
+            break;
+        case 3:
+            p.dead_time     += 0.25;
+            p.sensor_tau    += 0.5;
+            break;
+        default:
+            break;
+    }
+    return p;
+}
+const uint8_t   variants        = 4;
+
+struct BATCH {
+    std::vector<GAINS>  gains;
+    std::vector<SCORE>  scores;
+    uint8_t             first;                                              // The conditions to score the candidates
+    uint8_t             count;
+    bool                robust;                                             // Score by the worst of the plant variants
+    const GAINS        *table;                                              // The gain schedule the point 'first' runs in, zero - none
+    bool                smooth;                                             // Add the smoothness penalty with the table
+};
+
+// The smoothness penalty of the gain schedule point c with the coefficients g: the neighbours by the temperature
+// and by the fan speed. Kd can be zero, so the ratio is of k+1
+static double smoothness(const GAINS table[], uint8_t c, const GAINS &g) {
+    double p = 0;
+    uint8_t t = c / 3, f = c % 3;
+    for (uint8_t n = 0; n < cond_num; ++n) {
+        uint8_t nt = n / 3, nf = n % 3;
+        if (abs(int(nt) - int(t)) + abs(int(nf) - int(f)) != 1) continue;
+        for (uint8_t k = 0; k < 3; ++k) {
+            double r = log(double(g.k[k] + 1) / (table[n].k[k] + 1));
+            p += r * r;
+        }
+    }
+    return smooth_weight * p;
+}
+
+static void evaluateJob(void *ctx, size_t index) {
+    BATCH *b = (BATCH *)ctx;
+    b->scores[index] = evaluate(b->gains[index], b->first, b->count, plant_nominal, b->table);
+    for (uint8_t v = 1; b->robust && v < variants; ++v) {
+        SCORE s = evaluate(b->gains[index], b->first, b->count, variant(v), b->table);
+        if (s.cost > b->scores[index].cost) b->scores[index] = s;
+    }
+    if (b->table && b->smooth)
+        b->scores[index].cost += smoothness(b->table, b->first, b->gains[index]);
+}
+
+static size_t runBatch(THREAD_POOL &pool, BATCH &b) {
+    b.scores.resize(b.gains.size());
+    pool.run(evaluateJob, &b, b.gains.size());
+    size_t best = 0;
+    for (size_t i = 1; i < b.scores.size(); ++i)
+        if (b.scores[i].cost < b.scores[best].cost) best = i;
+    return best;
+}
+
+static void printScore(const char *title, const GAINS &g, const SCORE &s) {
+    if (g.k[0] < 0)
+        printf("%-10s [gain schedule]     cost %7.2f, ready %6.1f s (worst ", title, s.cost, s.ready);
+    else
+        printf("%-10s [%5d, %4d, %5d] cost %7.2f, ready %6.1f s (worst ", title, g.k[0], g.k[1], g.k[2], s.cost, s.ready);
+    if (s.ready_max < 0)
+        printf("never");
+    else
+        printf("%.1f s", s.ready_max);
+    printf("), overshoot %5.1f C, step ", s.overshoot);
+    if (s.step < 0)
+        printf("never");
+    else
+        printf("%.1f s", s.step);
+    printf(", fan %4.1f C\n", s.fan_dev);
+}
+
+// The grid value i of n in the logarithmic range; Kd grid starts from zero
+static int gridValue(uint8_t k, uint16_t i, uint16_t n) {
+    int lo = k_min[k];
+    if (lo == 0) {
+        if (i == 0) return 0;
+        lo = 1; --i; --n;
+    }
+    if (n <= 1) return lo;
+    return int(lo * pow(double(k_max[k]) / lo, double(i) / (n - 1)) + 0.5);
+}
+
+struct AUTO_TUNE {
+    CONDITION   cond;
+    bool        ok;
+    uint16_t    amplitude;                                                  // Internal units
+    uint32_t    period;                                                     // ms
+    double      time;                                                       // The experiment duration, s
+    GAINS       g;
+    SCORE       s;
+};
+
+static void relayCB(void *ctx, GUN_SIM *) {
+    ((RELAY_TUNE *)ctx)->update();
+}
+
+// Run the relay experiment as autoTuneSCREEN does, then score the coefficients found
+static void autoTuneJob(void *ctx, size_t index) {
+    AUTO_TUNE  &a = ((AUTO_TUNE *)ctx)[index];
+    GUN_SIM     sim;
+    RELAY_TUNE  relay(&sim.gun());
+    sim.init();
+    sim.onPeriod(relayCB, &relay);
+    sim.setFan(a.cond.fan);
+    relay.start(sim.config().tempInternal(a.cond.temp), sim.gun().getMaxFixedPower());
+    while (relay.status() == RELAY_TUNE::RT_HEAT || relay.status() == RELAY_TUNE::RT_RELAY)
+        sim.run(1);
+    a.time  = sim.time();
+    int16_t k[3];
+    a.ok    = relay.gains(k);
+    if (!a.ok) return;
+    a.amplitude = relay.amplitude();
+    a.period    = relay.periodMs();
+    for (uint8_t i = 0; i < 3; ++i)
+        a.g.k[i] = k[i];
+    a.s = evaluate(a.g);
+}
+
+static void autoTune(THREAD_POOL &pool) {
+    std::vector<AUTO_TUNE> runs(cond_num);
+    for (uint8_t c = 0; c < cond_num; ++c)
+        runs[c].cond = conditions[c];
+    pool.run(autoTuneJob, runs.data(), cond_num);
+    for (uint8_t c = 0; c < cond_num; ++c) {
+        const AUTO_TUNE &a = runs[c];
+        char title[16];
+        sprintf(title, "%u/%u", a.cond.temp, a.cond.fan);
+        if (!a.ok) {
+            printf("%-10s failed in %.0f s\n", title, a.time);
+            continue;
+        }
+        printScore(title, a.g, a.s);
+        printf("%-10s amplitude %u, period %.1f s, %.0f s to tune\n", "", a.amplitude, a.period * 1e-3, a.time);
+    }
+}
+
+// The pattern search: try to scale every coefficient up and down, shrink the scale when nothing is better.
+// The coefficients stay in the range of the PID kernel; zero in the gain schedule is the factory coefficient
+static GAINS refine(THREAD_POOL &pool, BATCH &b, GAINS best, SCORE &best_s, double scale, bool verbose) {
+    int k_low = b.table?1:0;
+    while (scale > 1.02) {
+        b.gains.clear();
+        for (uint8_t k = 0; k < 3; ++k) {
+            GAINS up = best, down = best;
+            up.k[k]   = int(best.k[k] * scale + 0.5);
+            if (up.k[k] == best.k[k]) ++up.k[k];
+            if (up.k[k] > PID_Q13::gain_max) up.k[k] = PID_Q13::gain_max;
+            down.k[k] = int(best.k[k] / scale + 0.5);
+            if (down.k[k] == best.k[k] && down.k[k] > k_low) --down.k[k];
+            if (down.k[k] < k_low) down.k[k] = k_low;
+            if (up.k[k] != best.k[k]) b.gains.push_back(up);
+            if (down.k[k] != best.k[k]) b.gains.push_back(down);
+        }
+        if (b.gains.empty()) break;
+        size_t best_i = runBatch(pool, b);
+        if (b.scores[best_i].cost < best_s.cost) {
+            best    = b.gains[best_i];
+            best_s  = b.scores[best_i];
+            if (verbose) printScore("refine", best, best_s);
+        } else {
+            scale = sqrt(scale);
+        }
+    }
+    return best;
+}
+
+// The coarse grid sweep, then the pattern search
+static GAINS search(THREAD_POOL &pool, BATCH &b, uint16_t points, bool verbose, SCORE &best_s) {
+    b.gains.clear();
+    for (uint16_t p = 0; p < points; ++p)
+        for (uint16_t i = 0; i < points; ++i)
+            for (uint16_t d = 0; d < points; ++d) {
+                GAINS g = { { gridValue(0, p, points), gridValue(1, i, points), gridValue(2, d, points) } };
+                b.gains.push_back(g);
+            }
+    size_t best_i   = runBatch(pool, b);
+    GAINS  best     = b.gains[best_i];
+    best_s          = b.scores[best_i];
+    if (verbose) printScore("grid", best, best_s);
+
+    double scale = sqrt(pow(double(k_max[0]) / k_min[0], 1.0 / (points - 1)));
+    return refine(pool, b, best, best_s, scale, verbose);
+}
+
+static void tuneSchedule(THREAD_POOL &pool, BATCH &b, uint16_t points, bool verbose) {
+    GAINS table[cond_num];
+    SCORE s;
+    b.first     = 0;                                                        // The common coefficients of all the points
+    b.count     = cond_num;
+    b.robust    = false;
+    b.table     = 0;
+    b.smooth    = false;
+    GAINS common = search(pool, b, points, verbose, s);
+    printScore("common", common, s);
+    for (uint8_t c = 0; c < cond_num; ++c) {
+        table[c] = common;
+        if (table[c].k[2] == 0) table[c].k[2] = 1;                          // Zero in the schedule is the factory one
+    }
+    for (uint8_t sweep = 0; sweep < schedule_sweeps; ++sweep) {
+        for (uint8_t c = 0; c < cond_num; ++c) {
+            b.first     = c;
+            b.count     = 1;
+            b.robust    = true;
+            b.table     = table;
+            b.smooth    = true;
+            b.gains.assign(1, table[c]);
+            runBatch(pool, b);
+            s = b.scores[0];
+            table[c] = refine(pool, b, table[c], s, 2.0, verbose);
+        }
+    }
+    b.gains.clear();                                                        // The final cost without the penalty
+    for (uint8_t c = 0; c < cond_num; ++c) {
+        char  title[16];
+        b.first     = c;
+        b.count     = 1;
+        b.smooth    = false;
+        b.gains.assign(1, table[c]);
+        runBatch(pool, b);
+        sprintf(title, "%u/%u", conditions[c].temp, conditions[c].fan);
+        printScore(title, table[c], b.scores[0]);
+    }
+
+    printf("\nPaste the factory PID gain schedule into gun.h:\n");
+    printf("const PID_TABLE\tpid_schedule = {\t\t\t\t\t\t\t\t\t\t\t// The factory PID gain schedule\n");
+    for (uint8_t t = 0; t < 3; ++t) {
+        printf("\t{ ");
+        for (uint8_t f = 0; f < 3; ++f) {
+            const GAINS &g = table[t*3 + f];
+            printf("{ %4d, %3d, %4d }%s", g.k[0], g.k[1], g.k[2], (f < 2)?", ":" }");
+        }
+        printf("%s\t\t// %u Celsius", (t < 2)?",":"", temp_tip[t]);
+        if (t == 0) printf(", fan %u, %u, %u", gs_fan[0], gs_fan[1], gs_fan[2]);
+        printf("\n");
+    }
+    printf("};\n");
+}
+
+int main(int argc, char *argv[]) {
+    unsigned    threads = 0;
+    uint16_t    points  = 8;
+    bool        verbose = false;
+    bool        relay   = false;
+    bool        table   = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:g:w:s:vta")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'g':
+                points = atoi(optarg);
+                if (points < 2) points = 2;
+                break;
+            case 'w':
+                overshoot_weight = atof(optarg);
+                break;
+            case 's':
+                smooth_weight = atof(optarg);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 't':
+                table = true;
+                break;
+            case 'a':
+                relay = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-j threads] [-g points] [-w weight] [-s weight] [-v] [-t | -a]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    THREAD_POOL pool(threads);
+    printf("%u threads, %u conditions\n", pool.size(), cond_num);
+
+    GAINS       schedule    = { { -1, -1, -1 } };
+    GAINS       factory     = { { pid_kp, pid_ki, pid_kd } };
+    BATCH       b;
+    b.first     = 0;
+    b.count     = cond_num;
+    b.robust    = false;
+    b.table     = 0;
+    b.smooth    = false;
+    b.gains.push_back(schedule);
+    b.gains.push_back(factory);
+    runBatch(pool, b);
+    printScore("current", schedule, b.scores[0]);
+    printScore("factory", factory, b.scores[1]);
+    if (relay) {
+        autoTune(pool);
+        return 0;
+    }
+    if (table) {
+        tuneSchedule(pool, b, points, verbose);
+        return 0;
+    }
+
+    SCORE  best_s;
+    GAINS  best = search(pool, b, points, verbose, best_s);
+    printScore("best", best, best_s);
+
+    char date[16];
+    time_t now = time(0);
+    strftime(date, sizeof(date), "%m/%d/%Y", localtime(&now));
+    printf("\nPaste the factory PID coefficients into gun.h:\n");
+    printf(" *  %s  [%5d, %4d, %3d]\n", date, best.k[0], best.k[1], best.k[2]);
+    printf("const int16_t\tpid_kp\t\t= %d;\t\t\t\t\t\t\t\t\t\t\t// The factory PID coefficients\n", best.k[0]);
+    printf("const int16_t\tpid_ki\t\t= %d;\n", best.k[1]);
+    printf("const int16_t\tpid_kd\t\t= %d;\n", best.k[2]);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hgtrace.h"
+
+//------------------------------------------ Sequential trace writer -----------------------------------------
+bool HGT_WRITER::open(const char *path, uint32_t period) {
+    close();
+    f = fopen(path, "wb");
+    if (!f) return false;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, hgt_magic, sizeof(hdr.magic));
+    hdr.version         = hgt_version;
+    hdr.header_size     = sizeof(HGT_HEADER);
+    hdr.record_size     = sizeof(HGT_RECORD);
+    hdr.index_size      = sizeof(HGT_INDEX);
+    hdr.period          = period;
+    index.clear();
+    new_session         = true;
+    last_mode           = 0;
+    return fwrite(&hdr, sizeof(hdr), 1, f) == 1;                            // The final header is written by close()
+}
+
+bool HGT_WRITER::add(HGT_RECORD r) {
+    if (!f) return false;
+    HGT_INDEX e = { hdr.records, r.time, 0, r.mode, 0 };
+    if (new_session) {
+        new_session = false;
+        ++hdr.sessions;
+        e.kind = HGT_SESSION;
+        index.push_back(e);
+    } else if (r.mode != last_mode) {
+        e.kind = HGT_MODE;
+        index.push_back(e);
+    }
+    last_mode   = r.mode;
+    r.session   = hdr.sessions - 1;
+    ++hdr.records;
+    return fwrite(&r, sizeof(r), 1, f) == 1;
+}
+
+bool HGT_WRITER::close(void) {
+    if (!f) return true;
+    hdr.index_offset    = sizeof(HGT_HEADER) + hdr.records * sizeof(HGT_RECORD);
+    hdr.index_entries   = index.size();
+    bool ok = index.empty() || fwrite(index.data(), sizeof(HGT_INDEX), index.size(), f) == index.size();
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+    f = 0;
+    return ok;
+}
+
+//------------------------------------------ Memory-mapped trace reader --------------------------------------
+bool HGT_FILE::open(const char *path) {
+    close();
+    err[0] = 0;
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(err, sizeof(err), "cannot open %s", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(HGT_HEADER)) {
+        snprintf(err, sizeof(err), "%s is not a trace file", path);
+        ::close(fd);
+        return false;
+    }
+    void *m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+        snprintf(err, sizeof(err), "cannot map %s", path);
+        return false;
+    }
+    base = (const uint8_t *)m;
+    size = st.st_size;
+    madvise(m, size, MADV_SEQUENTIAL);
+
+    const HGT_HEADER &h = header();
+    if (memcmp(h.magic, hgt_magic, sizeof(h.magic)) || h.version != hgt_version) {
+        snprintf(err, sizeof(err), "%s is not a trace file or the version is not supported", path);
+    } else if (h.record_size != sizeof(HGT_RECORD) || h.index_size != sizeof(HGT_INDEX) || h.header_size < sizeof(HGT_HEADER)) {
+        snprintf(err, sizeof(err), "%s: wrong record size", path);
+    } else if (h.header_size + h.records * sizeof(HGT_RECORD) > h.index_offset
+            || h.index_offset + h.index_entries * sizeof(HGT_INDEX) > size) {
+        snprintf(err, sizeof(err), "%s is truncated", path);
+    } else {
+        return true;
+    }
+    close();
+    return false;
+}
+
+void HGT_FILE::close(void) {
+    if (base) munmap((void *)base, size);
+    base = 0;
+    size = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef _HGTRACE_H_
+#define _HGTRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+//------------------------------------------ Binary trace file of the controller telemetry -------------------
+/* The file is the fixed size header, the fixed size records and the index, all little-endian:
+ *   HGT_HEADER | HGT_RECORD * records | HGT_INDEX * index_entries
+ * The record is the controller status sample (see telemetry.h), the temperatures are in internal units,
+ * the time is in ms since the beginning of the trace. The index lists the beginning of every session
+ * (the controller was reset or the telemetry stream was interrupted) and every power mode transition,
+ * so the sessions can be located and analyzed without scanning the file.
+ */
+const char      hgt_magic[8]        = { 'H', 'G', 'T', 'R', 'A', 'C', 'E', 0 };
+const uint16_t  hgt_version         = 1;
+
+struct HGT_HEADER {
+    char        magic[8];
+    uint16_t    version;
+    uint16_t    header_size;
+    uint16_t    record_size;
+    uint16_t    index_size;                                                 // The size of the index entry
+    uint64_t    records;                                                    // The number of records
+    uint64_t    index_offset;                                               // The file offset of the index
+    uint64_t    index_entries;
+    uint32_t    sessions;
+    uint32_t    period;                                                     // The nominal sampling period, ms
+    uint8_t     reserved[16];
+};
+
+struct HGT_RECORD {
+    uint32_t    time;                                                       // ms since the beginning of the trace
+    uint16_t    temp;                                                       // The current temperature, internal units
+    uint16_t    temp_set;                                                   // The preset temperature, internal units
+    uint16_t    fan;                                                        // The fan PWM duty
+    uint8_t     power;                                                      // The average power, %
+    uint8_t     mode;                                                       // HOTGUN::PowerMode
+    uint32_t    session;                                                    // The session number
+};
+
+struct HGT_INDEX {
+    uint64_t    record;                                                     // The first record of the session or in the new mode
+    uint32_t    time;
+    uint8_t     kind;                                                       // HGT_SESSION or HGT_MODE
+    uint8_t     mode;                                                       // The new power mode
+    uint16_t    reserved;
+};
+
+static_assert(sizeof(HGT_HEADER) == 64, "HGT_HEADER must be 64 bytes");
+static_assert(sizeof(HGT_RECORD) == 16, "HGT_RECORD must be 16 bytes");
+static_assert(sizeof(HGT_INDEX)  == 16, "HGT_INDEX must be 16 bytes");
+
+const uint8_t   HGT_SESSION         = 'S';
+const uint8_t   HGT_MODE            = 'M';
+
+//------------------------------------------ Sequential trace writer -----------------------------------------
+class HGT_WRITER {
+    public:
+        HGT_WRITER(void)                                                    { f = 0; }
+        ~HGT_WRITER(void)                                                   { close(); }
+        bool        open(const char *path, uint32_t period);
+        void        newSession(void)                                        { new_session = true; }
+        bool        add(HGT_RECORD r);                                      // The session field is set by the writer
+        bool        close(void);                                            // Write the index and the final header
+        uint64_t    records(void)                                   const   { return hdr.records; }
+    private:
+        FILE*       f;
+        HGT_HEADER  hdr;
+        std::vector<HGT_INDEX> index;
+        bool        new_session;
+        uint8_t     last_mode;
+};
+
+//------------------------------------------ Memory-mapped trace reader --------------------------------------
+class HGT_FILE {
+    public:
+        HGT_FILE(void)                                                      { base = 0; size = 0; }
+        ~HGT_FILE(void)                                                     { close(); }
+        bool                open(const char *path);                         // Map the file and check the header
+        void                close(void);
+        const char*         error(void)                             const   { return err; }
+        const HGT_HEADER&   header(void)                            const   { return *(const HGT_HEADER *)base; }
+        const HGT_RECORD*   records(void)                           const   { return (const HGT_RECORD *)(base + header().header_size); }
+        const HGT_INDEX*    index(void)                             const   { return (const HGT_INDEX *)(base + header().index_offset); }
+        size_t              bytes(void)                             const   { return size; }
+    private:
+        const uint8_t*      base;
+        size_t              size;
+        char                err[128];
+};
+
+#endif
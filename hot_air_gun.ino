@@ -13,6 +13,7 @@
 #include "gun.h"
 #include "screen.h"
 #include "vars.h"
+#include "trace.h"
 
 const uint8_t AC_SYNC_PIN   = 2;                                            // Outlet 220 v synchronization pin. Do not change!
 const uint8_t HOT_GUN_PIN   = 7;                                            // Hot gun heater management pin
@@ -40,15 +41,27 @@ workSCREEN   wrkScr(&hg,  &disp, &rotEncoder, &simpleBuzzer, &hgCfg);
 configSCREEN cfgScr(&hg,  &disp, &rotEncoder, &hgCfg);
 calibSCREEN  clbScr(&hg,  &disp, &rotEncoder, &simpleBuzzer, &hgCfg);
 tuneSCREEN   tuneScr(&hg, &disp, &rotEncoder, &simpleBuzzer);
+autoTuneSCREEN atuneScr(&hg, &disp, &simpleBuzzer, &hgCfg);
+autoCalibSCREEN acalScr(&hg, &disp, &simpleBuzzer, &hgCfg);
 errorSCREEN  errScr(&hg,  &disp, &simpleBuzzer);
 pidSCREEN    pidScr(&hg,  &rotEncoder);
 
 SCREEN 	*pCurrentScreen = &offScr;
 
-volatile bool	end_of_power_period = false;
+volatile bool	end_of_ctrl_period = false;
 
 void syncAC(void) {
-    end_of_power_period = hg.syncCB();
+    TRACE_EVENT(EVENT_TRACE::EV_SYNC, 0);
+    if (hg.syncCB())
+    	end_of_ctrl_period = true;											// Keep the flag till loop() calculates the power
+}
+
+ISR(ADC_vect) {
+	hg.adcCB();
+}
+
+ISR(TIMER0_COMPA_vect) {
+	hg.phaseCB();
 }
 
 void rotEncChange(void) {
@@ -59,7 +72,9 @@ void checkReedStatus(void) {
 	static uint32_t check_sw = 0;
 	if (millis() > check_sw) {
 		uint16_t on = 0;
-		if (digitalRead(REED_SW_PIN)) on = 100;
+		uint8_t  level = digitalRead(REED_SW_PIN);
+		TRACE_LEVEL(EVENT_TRACE::EV_REED, level);
+		if (level) on = 100;
 		reedSwitch.update(on);												// If reed switch open, write 100;
 		check_sw = millis() + 100;
 	}
@@ -77,6 +92,10 @@ void setup() {
 	uint16_t fan	= hgCfg.fanPreset();
 	hg.setTemp(temp);
 	hg.setFan(fan);
+	uint16_t gs_temp[3];
+	hgCfg.scheduleTemp(gs_temp);
+	hg.gainSchedule(hgCfg.pidTable(), gs_temp);								// The PID coefficients by the preset temperature and fan speed
+	hg.powerModel(hgCfg.powerTable(), gs_temp);								// The learned steady-state power
 
     pinMode(REED_SW_PIN, INPUT_PULLUP);
     reedSwitch.init(10, 30, 60);
@@ -94,8 +113,12 @@ void setup() {
     cfgScr.next     = &offScr;
     cfgScr.calib    = &clbScr;
     cfgScr.tune     = &tuneScr;
+    cfgScr.autotune = &atuneScr;
+    cfgScr.autocalib = &acalScr;
     clbScr.next     = &offScr;
     tuneScr.next    = &offScr;
+    atuneScr.next   = &offScr;
+    acalScr.next    = &offScr;
 	errScr.next     = &offScr;
 
     pCurrentScreen->init();
@@ -107,6 +130,7 @@ void loop() {
 	static uint32_t ac_check 	    = 5000;
 
 	checkReedStatus();
+	TRACE_FLUSH();
 	int16_t pos = rotEncoder.read();
     if (reset_encoder) {
         old_pos = pos;
@@ -156,9 +180,9 @@ void loop() {
         reset_encoder = true;
 	}
 	
-	if (end_of_power_period) {												// Calculate the required power
+	if (end_of_ctrl_period) {												// Calculate the required power
+		end_of_ctrl_period = false;
 		hg.keepTemp();
-		end_of_power_period = false;
 	}
 
 	if (millis() > ac_check) {
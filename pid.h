@@ -0,0 +1,95 @@
+#ifndef _PID_H_
+#define _PID_H_
+
+#include <stdint.h>
+
+//------------------------------------------ PID kernel in the fixed-point arithmetic -------------------------
+/* The arithmetic of the PID algorithm (see class PID in gun.h) for the given number format:
+ *   Q    - the coefficients are multiplied by 2^Q (the common denominator)
+ *   GAIN - the coefficient type
+ *   ACC  - the power accumulator type
+ * The products of the coefficient and the temperature difference are GAIN x int16_t -> ACC, i.e. 16x16->32 bit
+ * multiplications on the AVR instead of the 32x32 bit 'long' ones. The power accumulator and the integral
+ * saturate instead of overflowing; without the saturation the result is exactly the same as of the 'long' code.
+ * The faster loop running r times per power period multiplies the temperature differences by r and r*r instead
+ * of the coefficients, so the coefficients keep the whole GAIN range at any rate. The power divided by r is the
+ * multiplication by the reciprocal calculated once by reciprocal(), there is no divide in the control loop.
+ */
+template <uint8_t Q, typename GAIN = int16_t, typename ACC = int32_t>
+class PID_KERNEL {
+    public:
+        static constexpr ACC    acc_max     = ACC(~(ACC(1) << (sizeof(ACC)*8 - 1)));
+        static constexpr ACC    acc_min     = -acc_max - 1;
+        static constexpr GAIN   gain_max    = GAIN(~(GAIN(1) << (sizeof(GAIN)*8 - 1)));
+        static_assert(sizeof(ACC) >= sizeof(GAIN) + 2, "The accumulator should be wider than the coefficient");
+        static_assert(Q > 0 && Q < sizeof(ACC)*8 - 1, "Wrong number of the fraction bits");
+
+        static ACC  mul(GAIN k, int16_t x)                                  { return ACC(k) * ACC(x);   }
+        static ACC  add(ACC a, ACC b) {                                     // a + b, saturated
+            if (b > 0 && a > acc_max - b) return acc_max;
+            if (b < 0 && a < acc_min - b) return acc_min;
+            return a + b;
+        }
+        static ACC  summLimit(GAIN ki)                                      { return (ki > 0)?acc_max / ki:acc_max; }
+        // The integral summ saturated so the Ki * summ product does not overflow
+        static ACC  integrate(ACC summ, int16_t diff, ACC limit) {
+            summ = add(summ, diff);
+            if (summ >  limit) return  limit;
+            if (summ < -limit) return -limit;
+            return summ;
+        }
+        // The direct formula: Kp*(Xs - Xn) + Ki*summ
+        static ACC  direct(GAIN kp, GAIN ki, int16_t diff, ACC summ)        { return add(mul(kp, diff), ACC(ki) * summ); }
+        // The direct formula of the faster loop, the result is multiplied by r: Kp*r*(Xs - Xn) + Ki*summ
+        static ACC  direct(GAIN kp, GAIN ki, int16_t diff, ACC summ, uint8_t r) {
+            return add(rateMul(mul(kp, diff), r), ACC(ki) * summ);
+        }
+        // The iterative formula increment: Kp*(Xn-1 - Xn) + Ki*(Xs - Xn) + Kd*(Xn-2 + Xn - 2*Xn-1)
+        // The temperatures are less than 4096, so the sum of the products cannot overflow
+        static ACC  delta(GAIN kp, GAIN ki, GAIN kd, int16_t t_set, int16_t t_curr, int16_t t_h0, int16_t t_h1) {
+            return mul(kp, t_h1 - t_curr) + mul(ki, t_set - t_curr) + mul(kd, t_h0 + t_curr - 2*t_h1);
+        }
+        // The increment of the faster loop running r times per power period, the result is multiplied by r:
+        // Kp*r*(Xn-1 - Xn) + Ki*(Xs - Xn) + Kd*r*r*(Xn-2 + Xn - 2*Xn-1)
+        static ACC  delta(GAIN kp, GAIN ki, GAIN kd, int16_t t_set, int16_t t_curr, int16_t t_h0, int16_t t_h1, uint8_t r) {
+            ACC p = add(mul(kp, rateDiff(t_h1 - t_curr, r)), mul(ki, t_set - t_curr));
+            return add(p, mul(kd, rateDiff(t_h0 + t_curr - 2*t_h1, uint16_t(r) * r)));
+        }
+        // Multiply the power by the denominator
+        static ACC  scale(int16_t power)                                    { return ACC(power) << Q;   }
+        // Divide the power by the denominator with rounding
+        static ACC  output(ACC power)                                       { return add(power, ACC(1) << (Q-1)) >> Q; }
+        // Divide the power multiplied by r by the denominator with rounding, r_mul and r_shift are of reciprocal(r).
+        // The result is exact when it is not negative; the negative power returns zero, the caller clamps it anyway
+        static ACC  output(ACC power, uint8_t r, uint16_t r_mul, uint8_t r_shift) {
+            if (r <= 1) return output(power);
+            ACC u = add(power, ACC(r) << (Q-1)) >> Q;
+            if (u <= 0) return 0;
+            if (u > 32767) u = 32767;
+            return (uint32_t(u) * r_mul) >> r_shift;
+        }
+        // u / r == (u * r_mul) >> r_shift for every 0 <= u < 2^15 (Granlund, Montgomery): r_shift = 15 + ceil(log2(r)),
+        // r_mul = ceil(2^r_shift / r) fits 16 bits. The only divide, when the rate changed
+        static void reciprocal(uint8_t r, uint16_t &r_mul, uint8_t &r_shift) {
+            uint8_t l = 0;
+            while ((uint16_t(1) << l) < r) ++l;
+            r_shift = 15 + l;
+            r_mul   = ((uint32_t(1) << r_shift) + r - 1) / r;
+        }
+    private:
+        // The temperature difference multiplied by r, saturated. Only the broken sensor jumps so far
+        static int16_t  rateDiff(int16_t d, uint16_t r) {
+            int32_t v = int32_t(d) * r;
+            if (v >  32767) return  32767;
+            if (v < -32767) return -32767;
+            return int16_t(v);
+        }
+        // a * r, a is saturated to acc_max/256 first, that is far beyond the full power
+        static ACC  rateMul(ACC a, uint8_t r) {
+            if (a >  (acc_max >> 8)) a =  (acc_max >> 8);
+            if (a < -(acc_max >> 8)) a = -(acc_max >> 8);
+            return a * r;
+        }
+};
+
+#endif
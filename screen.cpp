@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "screen.h"
+#include "telemetry.h"
 
 //---------------------------------------- class mainSCREEN [the hot air gun is OFF] ---------------------------
 
@@ -11,6 +12,9 @@ void mainSCREEN::init(void) {
     used = !pHG->isCold();
     cool_notified = !used;
     if (used) {                                                             // the hot gun was used, we should save new data in EEPROM
+        PWR_TABLE pwr;
+        pHG->learnedPower(pwr);
+        pCfg->savePower(pwr);
         pCfg->save(temp_set, pHG->presetFan());
     }
     mode_change = 0;														// Start adjusting temperature mode
@@ -130,12 +134,17 @@ SCREEN* workSCREEN::show(void) {
     int temp      = pHG->averageTemp();
     int tempH     = pCfg->tempHuman(temp);
     pD->tCurr(tempH);
-    pD->msgON();
+    uint16_t left = pHG->readyTime();
+    if (ready || left == 0xFFFF) {
+        pD->msgON();
+    } else {
+        pD->msgTimeLeft(left);                                              // Count down to the 'Ready' state
+    }
     uint8_t p   = pHG->appliedPower();
     pD->appliedPower(p);
     pD->fanSpeed(pHG->fanSpeed());
 
-    if ((abs(temp_set - temp) < 5) && (pHG->tempDispersion() <= 60))  {
+    if (pHG->isReady())  {                                                  // The temperature converged into the band
         if (!ready) {
             pBz->shortBeep();
             ready = true;
@@ -167,11 +176,19 @@ SCREEN* workSCREEN::reedSwitch(bool on) {
     return this; 
 }
 
+// Recalculate the PID coefficients and the power model when the gain schedule or the calibration changed
+static void applySchedule(HOTGUN* pHG, HOTGUN_CFG* pCfg) {
+    uint16_t temp[3];
+    pCfg->scheduleTemp(temp);
+    pHG->gainSchedule(pCfg->pidTable(), temp);
+    pHG->powerModel(pCfg->powerTable(), temp);
+}
+
 //---------------------------------------- class configSCREEN [configuration menu] -----------------------------
 void configSCREEN::init(void) {
     pHG->switchPower(false);
     mode = 0;
-    pEnc->reset(mode, 0, 4, 1, 0, true);          
+    pEnc->reset(mode, 0, 6, 1, 0, true);          
     pD->clear();
     pD->setupMode(0);
     this->scr_timeout = 30;                                                 // This variable is defined in the superclass
@@ -189,17 +206,24 @@ SCREEN* configSCREEN::menu(void) {
         case 0:                                                             // calibrate hotgun
             if (calib) return calib;
             break;
-        case 1:                                                             // Tune potentiometer
+        case 1:                                                             // Calibrate by the reference thermometer
+            if (autocalib) return autocalib;
+            break;
+        case 2:                                                             // Tune potentiometer
             if (tune) return tune;
             break;
-        case 2:                                                             // Save configuration data
+        case 3:                                                             // PID auto-tune
+            if (autotune) return autotune;
+            break;
+        case 4:                                                             // Save configuration data
             menu_long();
             break;
-        case 3:                                                             // Cancel, Return to the main menu
+        case 5:                                                             // Cancel, Return to the main menu
             if (next) return next;
             break;
-        case 4:                                                             // Save defaults
+        case 6:                                                             // Save defaults
             pCfg->setDefaults(true);
+            applySchedule(pHG, pCfg);                                       // Return to the factory PID gain schedule
             if (next) return next;
             break;
     }
@@ -216,7 +240,7 @@ void configSCREEN::rotaryValue(int16_t value) {
 void calibSCREEN::init(void) {
     pHG->switchPower(false);
     ref_temp_index 		= 0;
-    pEnc->reset(ref_temp_index, 0, 2, 1, 1, true);							// Select reference temperature point using Encoder
+    pEnc->reset(ref_temp_index, 0, calib_points-1, 1, 1, true);			// Select reference temperature point using Encoder
     pCfg->getCalibrationData(calib_temp);									// Load Current calibration data
     pHG->setFan(tune_fan_speed);
     ref_temp_index 		= 0;
@@ -227,7 +251,7 @@ void calibSCREEN::init(void) {
     pD->clear();
     pD->msgOFF();
     pD->fanSpeed(tune_fan_speed);
-    pD->tSet(temp_tip[ref_temp_index]);
+    pD->tSet(calib_tip[ref_temp_index]);
     forceRedraw();
 }
 
@@ -237,11 +261,10 @@ SCREEN* calibSCREEN::show(void) {
 
     int16_t temp        = pHG->averageTemp(); 								// Actual GUN temperature
     int16_t temp_set    = pHG->presetTemp();
-    uint16_t tempH      = pCfg->tempHuman(temp);
     uint8_t  power		= pHG->avgPowerPcnt();
     uint16_t pwr_disp	= pHG->pwrDispersion();
 
-    if (tuning && (abs(temp_set - temp) <= 4) && (pwr_disp <= pwr_disp_max) && power > 1)  {
+    if (tuning && (abs(temp_set - temp) <= 16) && (pwr_disp <= pwr_disp_max) && power > 1)  {
     	if (!ready && temp_setready_ms && (millis() > temp_setready_ms)) {
     		pBz->shortBeep();
     		ready 				= true;
@@ -266,7 +289,7 @@ void calibSCREEN::rotaryValue(int16_t value) {  							// The Encoder rotated
     	temp_setready_ms = millis() + 5000;    								// Prevent beep just right the new temperature setup
     	pD->tInternal(value);
     } else {
-    	pD->tSet(temp_tip[value]);
+    	pD->tSet(calib_tip[value]);
     }
 }
 
@@ -278,22 +301,22 @@ SCREEN* calibSCREEN::menu(void) {               							// Rotary encoder pressed
 	    	uint16_t temp	= pHG->averageTemp();							// The temperature of the Hot Air Gun in internal units
 		    uint8_t ref 	= ref_temp_index;
 		    calib_temp[ref] = temp;
-		    uint16_t gun[3];
-		    for (uint8_t i = 0; i < 3; ++i) {
+		    uint16_t gun[max_calib_points];
+		    for (uint8_t i = 0; i < calib_points; ++i) {
 		    	gun[i] = calib_temp[i];
 		    }
-		    buildCalibration(gun, ref);										// ref is 0 for 200 degrees and 2 for 400 degrees
+		    buildCalibration(gun, ref);										// ref is the index of the reference point in calib_tip
 		    pCfg->applyCalibrationData(gun);
 		    pD->calibReady(false);
 	    }
 	    tuning	= false;
-	    pEnc->reset(ref_temp_index, 0, 2, 1, 1, true);						// Turn back to the reference temperature point selection mode
+	    pEnc->reset(ref_temp_index, 0, calib_points-1, 1, 1, true);			// Turn back to the reference temperature point selection mode
 	} else {																// Reference temperature index was selected from the list
 		ref_temp_index 	= pEnc->read();
 		tuning 			= true;
-		uint16_t tempH 	= temp_tip[ref_temp_index];							// Read the preset temperature from encoder (see vars.cpp)
+		uint16_t tempH 	= calib_tip[ref_temp_index];						// Read the preset temperature from encoder (see vars.cpp)
 		uint16_t temp 	= pCfg->tempInternal(tempH);
-		pEnc->reset(temp, 100, temp_max, 1, 5, false); 						// temp_max declared in vars.cpp
+		pEnc->reset(temp, 400, temp_max, 1, 20, false); 					// temp_max declared in vars.cpp
 		pHG->setTemp(temp);
 		pHG->switchPower(true);
 	}
@@ -303,9 +326,10 @@ SCREEN* calibSCREEN::menu(void) {               							// Rotary encoder pressed
 
 SCREEN* calibSCREEN::menu_long(void) {      								// Save new Hot Air Gun calibration data
     pHG->switchPower(false);
-	buildCalibration(calib_temp, 10); 										// 10 is bigger then the last index in the reference temp. Means build final calibration
+	buildCalibration(calib_temp, max_calib_points);							// Bigger then the last index in the reference temp. Means build final calibration
 	pCfg->applyCalibrationData(calib_temp);
 	pCfg->saveCalibrationData(calib_temp);
+	applySchedule(pHG, pCfg);
 	uint16_t temp = pCfg->tempPreset();
 	pHG->setTemp(temp);
 	uint8_t fan = pCfg->fanPreset();
@@ -316,20 +340,22 @@ SCREEN* calibSCREEN::menu_long(void) {      								// Save new Hot Air Gun cali
 }
 
 void calibSCREEN::buildCalibration(uint16_t gun[], uint8_t ref_point) {
-	if (gun[2] > temp_max) gun[2] = temp_max;								// int_temp_max is a maximum possible temperature (vars.cpp)
+	const uint8_t last = calib_points - 1;
+	if (gun[last] > temp_max) gun[last] = temp_max;							// int_temp_max is a maximum possible temperature (vars.cpp)
 
-	const int req_diff = 200;
-	if (ref_point <= 2) {													// gun[0-2] - internal temperature readings for the Hot Air Gun at reference points (200-400)
-		for (uint8_t i = ref_point; i <= 2; ++i) {							// ref_point is 0 for 200 degrees and 3 for 400 degrees
+	if (ref_point <= last) {												// gun[] - internal temperature readings for the Hot Air Gun at reference points (calib_tip)
+		for (uint8_t i = ref_point; i < last; ++i) {						// ref_point is the index of the reference point in calib_tip
+			int req_diff = (calib_tip[i+1] - calib_tip[i]) * req_slope;
 			int diff = (int)gun[i+1] - (int)gun[i];
 			if (diff < req_diff) {
 				gun[i+1] = gun[i] + req_diff;								// Increase right neighborhood temperature to keep the difference
 			}
 		}
-		if (gun[2] > temp_max)												// The high temperature limit is exceeded, temp_max. Lower all calibration
-			gun[2] = temp_max;
+		if (gun[last] > temp_max)											// The high temperature limit is exceeded, temp_max. Lower all calibration
+			gun[last] = temp_max;
 
-		for (int8_t i = 2; i > 0; --i) {
+		for (int8_t i = last; i > 0; --i) {
+			int req_diff = (calib_tip[i] - calib_tip[i-1]) * req_slope;
 			int diff = (int)gun[i] - (int)gun[i-1];
 			if (diff < req_diff) {
 				int t = (int)gun[i] - req_diff;					// Decrease left neighborhood temperature to keep the difference
@@ -373,7 +399,7 @@ SCREEN* tuneSCREEN::show(void) {
     }
     pD->tInternal(temp);
     pD->appliedPower(power);
-    if (heat_ms && ((millis() - heat_ms) > 3000) && (pHG->tempDispersion() < 10) && (power > 1)) {
+    if (heat_ms && ((millis() - heat_ms) > 3000) && (pHG->tempDispersion() < 160) && (power > 1)) {
         pBz->shortBeep();
         heat_ms = 0;
     }
@@ -402,6 +428,117 @@ SCREEN* tuneSCREEN::menu_long(void) {
     return this;
 }
 
+//---------------------------------------- class autoTuneSCREEN [PID auto-tune by the relay feedback] ---------
+void autoTuneSCREEN::init(void) {
+    pHG->switchPower(false);
+    uint16_t temp = pCfg->tempPreset();
+    uint16_t fan  = pCfg->fanPreset();
+    pCfg->schedulePoint(temp, fan);											// Tune the PID in the gain schedule point nearest to the preset one
+    pHG->setTemp(temp);
+    pHG->setFan(fan);
+    relay.start(temp, pHG->getMaxFixedPower());
+    finished = false;
+    pD->clear();
+    pD->msgAutoTune(relay.cycle(), relay.totalCycles());
+    pD->msgON();
+    forceRedraw();
+}
+
+SCREEN* autoTuneSCREEN::show(void) {
+    if (!finished) {
+        RELAY_TUNE::Status status = relay.update();							// Check the temperature as often as possible
+        if (status == RELAY_TUNE::RT_DONE || status == RELAY_TUNE::RT_FAILED) {
+            finish(status);
+            return this;
+        }
+    }
+    if (finished || millis() < update_screen) return this;
+    update_screen = millis() + period;
+    pD->msgAutoTune(relay.cycle(), relay.totalCycles());
+    pD->tInternal(pHG->averageTemp());
+    pD->appliedPower(relay.power());
+    return this;
+}
+
+SCREEN* autoTuneSCREEN::menu_long(void) {
+    relay.stop();															// Abort the experiment
+    pHG->switchPower(false);
+    if (next) return next;
+    return this;
+}
+
+void autoTuneSCREEN::finish(RELAY_TUNE::Status status) {
+    finished = true;
+    pHG->switchPower(false);
+    pD->msgOFF();
+    int16_t k[3];
+    if (status == RELAY_TUNE::RT_DONE && relay.gains(k)) {
+        pCfg->savePID(pHG->presetTemp(), pHG->presetFan(), k);				// Into the nearest point of the gain schedule
+        applySchedule(pHG, pCfg);
+        pD->pidGains(k[0], k[1], k[2]);
+        pBz->doubleBeep();
+    } else {
+        pD->msgFail();
+        pBz->failedBeep();
+    }
+}
+
+//---------------------------------------- class autoCalibSCREEN [calibration by the reference thermometer] ----
+void autoCalibSCREEN::init(void) {
+    pHG->switchPower(false);
+    calib.start();
+    finished = false;
+    pD->clear();
+    pD->msgAutoCalib(1, calib_points, calib_tip[0]);
+    pD->msgON();
+    pD->fanSpeed(tune_fan_speed);
+    forceRedraw();
+}
+
+SCREEN* autoCalibSCREEN::show(void) {
+    if (!finished) {
+        AUTO_CALIB::Status status = calib.update();							// Read the meter as often as possible
+        if (status == AUTO_CALIB::AC_DONE || status == AUTO_CALIB::AC_FAILED) {
+            finish(status);
+            return this;
+        }
+    }
+    if (finished || millis() < update_screen) return this;
+    update_screen = millis() + period;
+    uint8_t point = calib.point();
+    pD->msgAutoCalib(point+1, calib_points, calib_tip[point]);
+    REF_METER& meter = calib.meter();
+    pD->tCurr(meter.fresh()?(meter.temp10() + 5) / 10:1000);				// The reference thermometer reading, 'xxxx' if no one
+    pD->appliedPower(pHG->avgPowerPcnt());
+    return this;
+}
+
+SCREEN* autoCalibSCREEN::menu_long(void) {
+    calib.stop();															// Abort the calibration, keep the current one
+    if (next) return next;
+    return this;
+}
+
+void autoCalibSCREEN::finish(AUTO_CALIB::Status status) {
+    finished = true;
+    pHG->switchPower(false);
+    pD->msgOFF();
+    if (status == AUTO_CALIB::AC_DONE) {
+        uint16_t gun[max_calib_points];
+        calib.result(gun);
+        pCfg->applyCalibrationData(gun);
+        pCfg->saveCalibrationData(gun);
+        applySchedule(pHG, pCfg);											// The gain schedule points depend on the calibration
+        uint16_t temp = pCfg->tempPreset();
+        pHG->setTemp(temp);
+        pCfg->save(temp, pCfg->fanPreset());
+        pBz->doubleBeep();
+    } else {
+        pD->msgFail();
+        pBz->failedBeep();
+    }
+}
+
 //---------------------------------------- class pidSCREEN [tune the PID coefficients] -------------------------
 void pidSCREEN::init(void) {
     temp_set = pHG->presetTemp();
@@ -464,6 +601,10 @@ void pidSCREEN::rotaryValue(int16_t value) {
 SCREEN* pidSCREEN::show(void) {
     if (millis() < update_screen) return this;
     update_screen = millis() + period;
+#ifdef TELEMETRY_BINARY
+    TELEMETRY::send(pHG->getCurrTemp(), temp_set, pHG->fanSpeed(), pHG->averagePower(), pHG->powerMode());
+    return this;                                                            // Send the power mode transitions as well
+#endif
     if (pHG->isOn()) {
         char buff[80];
         int      temp   = pHG->getCurrTemp();
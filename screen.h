@@ -7,6 +7,8 @@
 #include "display.h"
 #include "buzzer.h"
 #include "config.h"
+#include "autotune.h"
+#include "autocalib.h"
 #include "vars.h"
 
 //------------------------------------------ class SCREEN ------------------------------------------------------
@@ -24,8 +26,8 @@ class SCREEN {
         virtual SCREEN* show(void)                          			{ return this; }
         virtual SCREEN* menu(void)                          			{ return this; }
         virtual SCREEN* menu_long(void)                     			{ if (this->next != 0)  return this->next;  else return this; }
-        virtual SCREEN* reedSwitch(bool on)                 			{ return this; }
-        virtual void    rotaryValue(int16_t value)          			{ }
+        virtual SCREEN* reedSwitch(bool)                    			{ return this; }
+        virtual void    rotaryValue(int16_t)                			{ }
         void            forceRedraw(void)                   			{ update_screen = 0; }
     protected:
         uint32_t update_screen;                             			// Time in ms when the screen should be updated
@@ -124,12 +126,14 @@ class configSCREEN : public SCREEN {
         virtual void    rotaryValue(int16_t value);
         SCREEN*         calib				= 0;							// Pointer to the calibration SCREEN
         SCREEN*         tune				= 0;							// Pointer to the tune SCREEN
+        SCREEN*         autotune			= 0;							// Pointer to the PID auto-tune SCREEN
+        SCREEN*         autocalib			= 0;							// Pointer to the automatic calibration SCREEN
     private:
         HOTGUN*     pHG;                                                    // Pointer to the HOTGUN instance
         DSPL*       pD;                                                     // Pointer to the DSPLay instance
         RENC*    	pEnc;                                                   // Pointer to the rotary encoder instance
         HOTGUN_CFG* pCfg;                                                   // Pointer to the config instance
-        uint8_t     mode					= 0;							// 0 - hotgun calibrate, 1 - tune, 2 - save, 3 - cancel, 4 - defaults
+        uint8_t     mode					= 0;							// 0 - hotgun calibrate, 1 - auto calibrate, 2 - tune, 3 - auto tune, 4 - save, 5 - cancel, 6 - defaults
         const uint16_t period = 10000;                                      // The period in ms to update the screen
 };
 
@@ -155,14 +159,15 @@ class calibSCREEN : public SCREEN {
         RENC*    	pEnc;													// Pointer to the rotary encoder instance
         HOTGUN_CFG* pCfg;													// Pointer to the config instance
         BUZZER*     pBz;													// Pointer to the buzzer instance
-        uint8_t		ref_temp_index		= 0;								// Which temperature reference to change: [0-3]
-        uint16_t	calib_temp[3];											// The calibration temp. in internal units in reference points
+        uint8_t		ref_temp_index		= 0;								// Which temperature reference to change: [0 - calib_points-1]
+        uint16_t	calib_temp[max_calib_points];							// The calibration temp. in internal units in reference points (calib_tip)
         bool		ready				= 0;								// Whether the temperature has been established
         bool		tuning				= 0;								// Whether the reference temperature is modifying (else we select new reference point)
         uint32_t	temp_setready_ms	= 0;								// The time in ms when we should check the temperature is ready
         uint16_t	fan_speed			= 1500;								// The Hot Air Gun fan speed during calibration
         const uint32_t period = 1000;										// Update screen period
         const uint16_t pwr_disp_max	= 100;
+        const uint8_t  req_slope	= 2;									// The minimal internal units per Celsius between the reference points
 };
 
 //---------------------------------------- class tuneSCREEN [tune the potentiometer ] --------------------------
@@ -190,6 +195,54 @@ class tuneSCREEN : public SCREEN {
         const uint16_t period = 500;                                        // The period in ms to update the screen
 };
 
+//---------------------------------------- class autoTuneSCREEN [PID auto-tune by the relay feedback] ---------
+class autoTuneSCREEN : public SCREEN {
+    public:
+        autoTuneSCREEN(HOTGUN* HG, DSPL* DSP, BUZZER* Buzz, HOTGUN_CFG* Cfg) : relay(HG) {
+            pHG     = HG;
+            pD      = DSP;
+            pBz     = Buzz;
+            pCfg    = Cfg;
+        }
+        virtual void    init(void);
+        virtual SCREEN* show(void);
+        virtual SCREEN* menu(void)											{ return menu_long(); }
+        virtual SCREEN* menu_long(void);
+    private:
+        void        finish(RELAY_TUNE::Status status);						// Apply and save the PID coefficients or report the failure
+        RELAY_TUNE  relay;													// The relay feedback experiment
+        HOTGUN*     pHG;													// Pointer to the hot air gun instance
+        DSPL*       pD;														// Pointer to the display instance
+        BUZZER*     pBz;													// Pointer to the simple Buzzer instance
+        HOTGUN_CFG* pCfg;													// Pointer to the config instance
+        bool        finished				= false;						// Whether the experiment is over
+        const uint16_t period = 500;                                        // The period in ms to update the screen
+};
+
+//---------------------------------------- class autoCalibSCREEN [calibration by the reference thermometer] ----
+class autoCalibSCREEN : public SCREEN {
+    public:
+        autoCalibSCREEN(HOTGUN* HG, DSPL* DSP, BUZZER* Buzz, HOTGUN_CFG* Cfg) : calib(HG, Cfg) {
+            pHG     = HG;
+            pD      = DSP;
+            pBz     = Buzz;
+            pCfg    = Cfg;
+        }
+        virtual void    init(void);
+        virtual SCREEN* show(void);
+        virtual SCREEN* menu(void)											{ return menu_long(); }
+        virtual SCREEN* menu_long(void);
+    private:
+        void        finish(AUTO_CALIB::Status status);						// Apply and save the calibration or report the failure
+        AUTO_CALIB  calib;													// The calibration procedure
+        HOTGUN*     pHG;													// Pointer to the hot air gun instance
+        DSPL*       pD;														// Pointer to the display instance
+        BUZZER*     pBz;													// Pointer to the simple Buzzer instance
+        HOTGUN_CFG* pCfg;													// Pointer to the config instance
+        bool        finished				= false;						// Whether the calibration is over
+        const uint16_t period = 500;                                        // The period in ms to update the screen
+};
+
 //---------------------------------------- class pidSCREEN [tune the PID coefficients] -------------------------
 class pidSCREEN : public SCREEN {
     public:
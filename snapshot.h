@@ -0,0 +1,35 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <Arduino.h>
+
+//------------------------------------------ class SNAPSHOT: the value shared with the interrupt handler ------
+/* The 8-bit MCU reads the multi-byte value by several instructions, the interrupt can change it in the middle.
+ * The handler increments the generation counter after every change, loop() copies the value and repeats
+ * the copy if the counter has changed meanwhile. The reader never disables the interrupts, and the handler
+ * is never interrupted by loop(), so the writer needs no protocol either.
+ * The rare writes of loop() (set()) are protected by the few instructions long noInterrupts() window.
+ */
+template <typename T>
+class SNAPSHOT {
+    public:
+        SNAPSHOT(T v = T())                             { value = v; gen = 0; }
+        T               read(void) {                    // In loop(): the consistent copy
+            T       v;
+            uint8_t g;
+            do {
+                g = gen;
+                v = value;
+            } while (g != gen);
+            return v;
+        }
+        void            set(T v)                        { noInterrupts(); value = v; ++gen; interrupts(); }
+        // In the interrupt handler
+        T               isrRead(void)                   { return value;         }
+        void            write(T v)                      { value = v; ++gen;     }
+    private:
+        volatile T          value;
+        volatile uint8_t    gen;                        // The generation counter, incremented by every write
+};
+
+#endif
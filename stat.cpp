@@ -1,69 +1,75 @@
 #include <Arduino.h>
 #include "stat.h"
 
-//------------------------------------------ class HISTORY ----------------------------------------------------
-int32_t HIST::last(void) {
-    if (len == 0) return 0;
-    uint8_t i = len - 1;
-    if (index)
-        i = index - 1;
-    return queue[i];
+//-------------------------------------------class Exponential average ----------------------------------------
+// Update and read with the local copies: two divides instead of three and no volatile reloads
+int32_t EMP_AVERAGE::average(int32_t value) {
+    uint8_t  k       = emp_k;
+    uint8_t  round_v = k >> 1;
+    uint32_t data    = emp_data;
+    data += value - (data + round_v) / k;
+    emp_data = data;
+    return (data + round_v) / k;
 }
 
-int32_t HIST::read(void) {
-    int32_t sum = 0;
-    if (len == 0) return 0;
-    if (len == 1) return queue[0];
-    for (uint8_t i = 0; i < len; ++i) sum += queue[i];
-    sum += len >> 1;                                // round the average
-    sum /= len;
-    return sum;
+void EMP_AVERAGE::update(int32_t value) {
+    uint8_t  k      = emp_k;
+    uint32_t data   = emp_data;
+    emp_data = data + value - (data + (k >> 1)) / k;
 }
 
-int32_t HIST::average(int32_t value) {
-    update(value);
-    return read();
+int32_t EMP_AVERAGE::read(void) {
+    uint8_t round_v = emp_k >> 1;
+    return (emp_data + round_v) / emp_k;
 }
 
-void HIST::update(int32_t value) {
-    if (len < max_len) {
-        queue[len++] = value;
-    } else {
-        queue[index] = value;
-        if (++index >= max_len) index = 0;          // Use ring buffer
-    }
+//-------------------------------------------class APPROACH: the time to reach the preset temperature ----------
+void APPROACH::update(int16_t e) {
+    err[index] = e;
+    if (++index >= a_len) index = 0;
+    if (len < a_len) ++len;
 }
 
-uint32_t HIST::dispersion(void) {
-    if (len < 3) return 1000;
-    uint32_t sum = 0;
-    uint32_t avg = read();
-    for (uint8_t i = 0; i < len; ++i) {
-        int32_t q = queue[i];
-        q -= avg;
-        q *= q;
-        sum += q;
-    }
-    sum += len >> 1;
-    sum /= len;
-    return sum;
+// The least squares slope by four equidistant points: (3*(e3 - e0) + (e2 - e1)) / 10
+int16_t APPROACH::slope10(void) {
+    int16_t e[a_len];
+    for (uint8_t i = 0; i < a_len; ++i)
+        e[i] = err[(index + i) % a_len];
+    return 3 * (e[3] - e[0]) + (e[2] - e[1]);
 }
 
-//-------------------------------------------class Exponential average ----------------------------------------
-int32_t EMP_AVERAGE::average(int32_t value) {
-    uint8_t round_v = emp_k >> 1;
-    update(value);
-    return (emp_data + round_v) / emp_k;
+// log2(1 + k/16) * 256, k = 0..16
+static const uint16_t log2_frac[17] = {0, 22, 44, 63, 82, 100, 118, 134, 150, 165, 179, 193, 207, 220, 232, 244, 256};
+
+// log2(x) * 256: the bit length is the integer part, the mantissa is interpolated by the table, the error < 1/256
+uint16_t APPROACH::log2x256(uint16_t x) {
+    if (x == 0) return 0;
+    uint8_t n = 15;
+    for ( ; !(x & 0x8000); x <<= 1) --n;                    // Normalize the mantissa to 1.xxx in Q15
+    uint8_t  k = (x >> 11) & 0x0F;                          // The top 4 bits of the fraction
+    uint8_t  f = (x >> 3) & 0xFF;                           // The next 8 bits
+    uint16_t a = log2_frac[k];
+    return (uint16_t(n) << 8) + a + (((log2_frac[k+1] - a) * f) >> 8);
 }
 
-void EMP_AVERAGE::update(int32_t value) {
-    uint8_t round_v = emp_k >> 1;
-    emp_data += value - (emp_data + round_v) / emp_k;
+bool APPROACH::converged(void) {
+    if (len < a_len) return false;
+    int16_t e = error();
+    if (abs(e) >= tol) return false;
+    return abs(int32_t(e) * 10 + int32_t(slope10()) * ahead) < int32_t(tol) * 10;
 }
 
-int32_t EMP_AVERAGE::read(void) {
-    uint8_t round_v = emp_k >> 1;
-    return (emp_data + round_v) / emp_k;
+uint16_t APPROACH::timeLeft(void) {
+    if (len < a_len) return 0xFFFF;
+    if (converged()) return 0;
+    int16_t e = error();
+    if (abs(e) < tol) return ahead;                         // Inside the band, but still moving
+    int16_t s = slope10();
+    if ((e > 0 && s >= 0) || (e < 0 && s <= 0)) return 0xFFFF;  // Not approaching the preset temperature
+    uint32_t ln = (uint32_t(log2x256(abs(e)) - log2x256(tol)) * 177 + 128) >> 8;   // ln(|e| / tol) * 256, ln(2) = 177/256
+    uint32_t t  = (uint32_t(abs(e)) * 10 * ln / uint16_t(abs(s)) + 128) >> 8;
+    if (t > 999) return 0xFFFF;
+    return t;
 }
 
 void SWITCH::init(uint8_t h_len, uint16_t off, uint16_t on) {
@@ -4,25 +4,150 @@
 #include <stdint.h>
 
 //------------------------------------------ class HISTORY ----------------------------------------------------
-#define H_LENGTH 16
+/* The ring buffer of the last N values of type T. The sum and the sum of squares of the queue are updated
+ * when the value is added, so the average and the dispersion do not loop over the queue.
+ * The sums are 32-bit: N * max(|value|)^2 should fit 31 bits, e.g. 16 values of the 12-bit temperature.
+ * The history can be updated by the interrupt handler: the readers copy the fields by the generation counter
+ * as SNAPSHOT does (see snapshot.h), reset() and length() are for the time the handler is not attached.
+ */
+template <typename T = int16_t, uint8_t N = 16>
 class HIST {
     public:
-        HIST(uint8_t h_length = H_LENGTH)               { len = index = 0; max_len = h_length; }
-        void            length(uint8_t h_length)        { len = index = 0; if (h_length > H_LENGTH) h_length = H_LENGTH; max_len = h_length; }
-        void            reset()                         { len = index = 0; }
+        HIST(uint8_t h_length = N)                      { length(h_length); }
+        void            length(uint8_t h_length)        { if (h_length > N) h_length = N; max_len = h_length; reset(); }
+        void            reset()                         { len = index = 0; summ = 0; summ2 = 0; ++gen; }
         int32_t         last(void);
         int32_t         read(void);
-        int32_t         average(int32_t value);
+        int32_t         average(int32_t value)          { update(value); return read(); }
         void            update(int32_t value);
         uint32_t        dispersion(void);               // the math dispersion of the data
     private:
-        volatile int32_t    queue[H_LENGTH];
+        static int32_t  mean(int32_t sum, uint8_t n)    { return (sum + (n >> 1)) / n; }    // The rounded average
+        volatile T          queue[N];
+        volatile int32_t    summ;                       // The sum of the queue elements
+        volatile uint32_t   summ2;                      // The sum of the squares of the queue elements
         volatile uint8_t    len;                        // The number of elements in the queue
-        volatile uint8_t    max_len;                    // Maximum length of the queue, not greater than H_LENGTH
+        volatile uint8_t    max_len;                    // Maximum length of the queue, not greater than N
         volatile uint8_t    index;                      // The current element position, use ring buffer
+        volatile uint8_t    gen     = 0;                // The generation counter, incremented by every update
+};
+
+template <typename T, uint8_t N>
+int32_t HIST<T, N>::last(void) {
+    uint8_t g;
+    int32_t v;
+    do {
+        g = gen;
+        uint8_t i = len;
+        if (index) i = index;
+        v = (i == 0)?0:queue[i - 1];
+    } while (g != gen);
+    return v;
+}
+
+template <typename T, uint8_t N>
+int32_t HIST<T, N>::read(void) {
+    uint8_t g, n;
+    int32_t sum;
+    do {
+        g   = gen;
+        n   = len;
+        sum = summ;
+    } while (g != gen);
+    if (n == 0) return 0;
+    return mean(sum, n);
+}
+
+template <typename T, uint8_t N>
+void HIST<T, N>::update(int32_t value) {
+    T v = value;
+    if (len < max_len) {
+        queue[len++] = v;
+    } else {
+        T old = queue[index];
+        summ  -= old;
+        summ2 -= int32_t(old) * old;
+        queue[index] = v;
+        if (++index >= max_len) index = 0;          // Use ring buffer
+    }
+    summ  += v;
+    summ2 += int32_t(v) * v;
+    ++gen;
+}
+
+/* The sum of the squared deviations from the rounded average a:
+ * summ((q - a)^2) = summ2 - a * (2*summ - len*a)
+ */
+template <typename T, uint8_t N>
+uint32_t HIST<T, N>::dispersion(void) {
+    uint8_t  g, n;
+    int32_t  s;
+    uint32_t s2;
+    do {
+        g   = gen;
+        n   = len;
+        s   = summ;
+        s2  = summ2;
+    } while (g != gen);
+    if (n < 3) return 1000;
+    int32_t  avg = mean(s, n);
+    uint32_t sum = s2 - uint32_t(avg * (2 * s - int32_t(n) * avg));
+    sum += n >> 1;
+    sum /= n;
+    return sum;
+}
+
+//------------------------------------------ class MEDIAN: sliding median spike filter ----------------------
+/* The median of the last N values (N is odd). A spike shorter than N/2+1 values is removed completely
+ * instead of being spread over the moving average, the step passes delayed by N/2 values.
+ * The values are kept in the arrival order and sorted, the new value replaces the oldest one in the sorted
+ * array by the insertion, that is N/2 comparisons on average.
+ */
+template <typename T = int16_t, uint8_t N = 3>
+class MEDIAN {
+    public:
+        MEDIAN(void)                                    { reset(); }
+        void            reset(void)                     { len = index = 0; }
+        T               filter(T value);                // Add the value, return the median
+    private:
+        T               window[N];                      // The values in the arrival order, ring buffer
+        T               sorted[N];                      // The same values sorted
+        uint8_t         len;
+        uint8_t         index;                          // The position of the oldest value
+        static_assert(N & 1, "The median window length should be odd");
 };
 
+template <typename T, uint8_t N>
+T MEDIAN<T, N>::filter(T value) {
+    uint8_t i = len;
+    if (len < N) {                                      // Filling up the window
+        window[len++] = value;
+    } else {
+        T old = window[index];
+        window[index] = value;
+        if (++index >= N) index = 0;
+        for (i = 0; sorted[i] != old; ++i) ;            // The oldest value position in the sorted array
+        while ((i < N-1) && (sorted[i+1] < value)) {
+            sorted[i] = sorted[i+1];
+            ++i;
+        }
+    }
+    while ((i > 0) && (sorted[i-1] > value)) {
+        sorted[i] = sorted[i-1];
+        --i;
+    }
+    sorted[i] = value;
+    return sorted[(len - 1) >> 1];
+}
+
 //-------------------------------------------class Exponential average ----------------------------------------
+/* The exponential average of the length k keeps k times the average: data += value - round(data / k).
+ * The step response reaches 1 - (1 - 1/k)^n of the step after n updates: 63% after k updates, 95% after 3k,
+ * and then settles exactly on the new value (the rounded average is the fixed point), no steady-state bias.
+ * EMP_AVERAGE has the runtime length, every update and read divides by it: ~600 cycles each on the AVR.
+ * EMP_SHIFT has the length 2^SHIFT fixed at compile time, the divide is a shift (see hg_bench_prims),
+ * and it is bit-exact with EMP_AVERAGE of the same length.
+ */
 class EMP_AVERAGE {
     public:
         EMP_AVERAGE(uint8_t h_length = 8)               { emp_k = h_length; emp_data = 0; }
@@ -36,6 +161,46 @@ class EMP_AVERAGE {
         volatile    uint32_t    emp_data    = 0;
 };
 
+template <uint8_t SHIFT>
+class EMP_SHIFT {
+    public:
+        EMP_SHIFT(void)                                 { emp_data = 0; }
+        void            reset(void)                     { emp_data = 0; }
+        int32_t         average(int32_t value)          { update(value); return read(); }
+        void            update(int32_t value)           { emp_data += value - read(); }
+        int32_t         read(void)                      { return (emp_data + round_v) >> SHIFT; }
+        static const uint16_t   length  = 1 << SHIFT;
+    private:
+        static const uint32_t   round_v = (1UL << SHIFT) >> 1;
+        volatile    uint32_t    emp_data    = 0;
+};
+
+//-------------------------------------------class APPROACH: the time to reach the preset temperature ----------
+/* The error (the preset temperature minus the current one) is sampled once per power period.
+ * The least squares slope of the last samples gives the time constant of the exponential approach
+ * tau = -error/slope, the time to get into the band is tau * ln(|error| / band), ln is fixed-point by the bit length.
+ * The approach is converged when both the error and the error projected by the slope 'horizon' periods
+ * ahead are inside the band, so passing through the band with the overshoot is not the convergence.
+ */
+class APPROACH {
+    public:
+        APPROACH(uint8_t band = 20, uint8_t horizon = 4)  { tol = band; ahead = horizon; len = index = 0; }
+        void            reset(void)                     { len = index = 0; }
+        void            update(int16_t error);
+        bool            converged(void);
+        uint16_t        timeLeft(void);                 // The periods to get into the band, 0 - converged, 0xFFFF - unknown
+    private:
+        int16_t         slope10(void);                  // The slope of the error multiplied by 10
+        static uint16_t log2x256(uint16_t x);           // log2(x) * 256, fixed-point
+        int16_t         error(void)                     { return err[(index + a_len - 1) % a_len]; }
+        int16_t         err[4];                         // The ring buffer of the last errors
+        uint8_t         len;
+        uint8_t         index;                          // The position of the oldest error
+        uint8_t         tol;
+        uint8_t         ahead;
+        static const uint8_t a_len = 4;
+};
+
 class SWITCH : public EMP_AVERAGE {
     public:
         SWITCH(uint8_t len=8) : EMP_AVERAGE(len)			{ }
@@ -0,0 +1,25 @@
+#include <Arduino.h>
+#include "telemetry.h"
+
+//------------------------------------------ class TELEMETRY ---------------------------------------------------
+void TELEMETRY::send(uint16_t temp, uint16_t temp_set, uint16_t fan, uint8_t power, uint8_t mode) {
+    uint8_t  frame[tlm_frame_len];
+    uint32_t ms = millis();
+    frame[0]    = tlm_sync0;
+    frame[1]    = tlm_sync1;
+    for (uint8_t i = 0; i < 4; ++i)
+        frame[2+i] = uint8_t(ms >> (8*i));
+    frame[6]    = uint8_t(temp);
+    frame[7]    = uint8_t(temp >> 8);
+    frame[8]    = uint8_t(temp_set);
+    frame[9]    = uint8_t(temp_set >> 8);
+    frame[10]   = uint8_t(fan);
+    frame[11]   = uint8_t(fan >> 8);
+    frame[12]   = power;
+    frame[13]   = mode;
+    uint8_t summ = 0;
+    for (uint8_t i = 2; i < 2 + tlm_data_len; ++i)
+        summ += frame[i];
+    frame[14]   = summ;
+    Serial.write(frame, tlm_frame_len);
+}
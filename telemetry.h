@@ -0,0 +1,26 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+// Uncomment to send the controller status of the PID tuning screen as the binary frames instead of the text lines.
+// The captured serial output can be packed to the trace file by host/tools/hg_trace_pack
+//#define TELEMETRY_BINARY
+
+//------------------------------------------ class TELEMETRY ---------------------------------------------------
+/* The binary frame is 15 bytes long, the multi-byte fields are little-endian:
+ *   0xA5 0x5A <millis():4> <temp:2> <temp_set:2> <fan:2> <power:1> <mode:1> <checksum:1>
+ * The temperatures are in internal units, the checksum is the sum of the 12 data bytes. The text output
+ * can be intermixed with the frames, the receiver looks for the sync bytes and checks the checksum.
+ */
+const uint8_t   tlm_sync0           = 0xA5;
+const uint8_t   tlm_sync1           = 0x5A;
+const uint8_t   tlm_data_len        = 12;
+const uint8_t   tlm_frame_len       = tlm_data_len + 3;
+
+class TELEMETRY {
+    public:
+        static void send(uint16_t temp, uint16_t temp_set, uint16_t fan, uint8_t power, uint8_t mode);
+};
+
+#endif
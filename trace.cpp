@@ -0,0 +1,46 @@
+#include <Arduino.h>
+#include "trace.h"
+
+#ifdef EVENT_TRACE_ON
+EVENT_TRACE evTrace;
+#endif
+
+//------------------------------------------ class EVENT TRACE -------------------------------------------------
+void EVENT_TRACE::event(uint8_t type, uint16_t value) {
+    uint8_t next = (head + 1) & (trace_buff_len - 1);
+    if (next == tail) {                                                     // The buffer is full, drop the event
+        ++lost;
+        return;
+    }
+    buff[head].time     = micros();
+    buff[head].value    = value;
+    buff[head].type     = type;
+    head = next;
+}
+
+void EVENT_TRACE::level(uint8_t type, uint8_t value) {
+    uint8_t *last = (type == EV_BUTTON)?&button:&reed;
+    if (*last == value) return;
+    *last = value;
+    noInterrupts();
+    event(type, value);
+    interrupts();
+}
+
+void EVENT_TRACE::flush(void) {
+    char buff[24];
+    if (lost) {
+        noInterrupts();
+        uint16_t l = lost;
+        lost = 0;
+        interrupts();
+        sprintf(buff, "#%c 0 %u", EV_LOST, l);
+        Serial.println(buff);
+    }
+    for (uint8_t i = 0; i < trace_flush_max && tail != head; ++i) {         // The entries between tail and head are not modified by ISR
+        volatile EVENT &e = this->buff[tail];
+        sprintf(buff, "#%c %lu %u", e.type, (unsigned long)e.time, e.value);
+        Serial.println(buff);
+        tail = (tail + 1) & (trace_buff_len - 1);
+    }
+}
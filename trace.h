@@ -0,0 +1,50 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+// Uncomment to stream the input events to the serial port. The recorded trace can be replayed by host/tools/hg_replay
+//#define EVENT_TRACE_ON
+
+//------------------------------------------ class EVENT TRACE -------------------------------------------------
+/* Records the timestamped input events of the firmware into the ring buffer and prints them to the serial port
+ * one event per line: '#<type> <time in us> <value>'. The lines not started with '#' are ignored by the replay.
+ * event() must be called with the interrupts disabled (from the ISR), level() is called from the main loop
+ * and records the value only if it has been changed.
+ */
+const uint8_t   trace_buff_len      = 32;                                   // The ring buffer size, power of 2
+const uint8_t   trace_flush_max     = 4;                                    // Maximum events to be printed by one flush() call
+
+class EVENT_TRACE {
+    public:
+        typedef enum { EV_SYNC = 'S', EV_ADC = 'A', EV_ENCODER = 'E', EV_BUTTON = 'B', EV_REED = 'R', EV_LOST = 'L' } EventType;
+        EVENT_TRACE(void)                                                   { head = tail = 0; lost = 0; button = reed = 0xff; }
+        void        event(uint8_t type, uint16_t value);                    // Record the event (from ISR)
+        void        level(uint8_t type, uint8_t value);                     // Record the input level change (from the main loop)
+        void        flush(void);                                            // Print recorded events to the serial port
+    private:
+        struct EVENT {
+            uint32_t    time;                                               // micros() of the event
+            uint16_t    value;
+            uint8_t     type;
+        };
+        volatile    EVENT       buff[trace_buff_len];
+        volatile    uint8_t     head;                                       // Next event to be written
+        volatile    uint8_t     tail;                                       // Next event to be printed
+        volatile    uint16_t    lost;                                       // The number of dropped events (buffer overflow)
+        uint8_t     button;                                                 // The last recorded levels
+        uint8_t     reed;
+};
+
+#ifdef EVENT_TRACE_ON
+extern EVENT_TRACE evTrace;
+#define TRACE_EVENT(type, value)    evTrace.event((type), (value))
+#define TRACE_LEVEL(type, value)    evTrace.level((type), (value))
+#define TRACE_FLUSH()               evTrace.flush()
+#else
+#define TRACE_EVENT(type, value)
+#define TRACE_LEVEL(type, value)
+#define TRACE_FLUSH()
+#endif
+
+#endif
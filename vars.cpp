@@ -3,8 +3,21 @@
 const uint16_t temp_minC		= 100;										// Minimum temperature the controller can check accurately
 const uint16_t temp_maxC    	= 500;                                      // Maximum possible temperature
 const uint16_t temp_ambC    	= 25;                                       // Average ambient temperature
-const uint16_t temp_max     	= 950;                                      // Maximum possible temperature in internal units
-const uint16_t temp_tip[3] 		= {200, 300, 400};                          // Temperature reference points for calibration
+const uint16_t temp_max     	= 4000;                                      // Maximum possible temperature in internal units
+const uint16_t temp_cutoff		= (temp_max + 120 < 4080)?temp_max + 120:4080;	// The open sensor reads max_reading
+static_assert(temp_cutoff < max_reading, "The over heating cutoff is out of the reading range");
+const uint16_t temp_tip[3] 		= {200, 300, 400};                          // Temperature points of the PID gain schedule
+const uint8_t  calib_points		= 6;										// The number of the calibration reference points
+constexpr uint16_t calib_tip[max_calib_points] = {100, 150, 200, 300, 400, 480};	// Temperature reference points for calibration
+
+// The calibration segment spans less than 256 Celsius and is not empty, see HOTGUN_CFG::buildSegment()
+constexpr bool calibSpans(uint8_t i) {
+    return i >= calib_points || (calib_tip[i] > ((i > 0)?calib_tip[i-1]:temp_ambC) &&
+        calib_tip[i] - ((i > 0)?calib_tip[i-1]:temp_ambC) < 256 && calibSpans(i+1));
+}
+static_assert(calib_points >= 2 && calib_points <= max_calib_points, "Wrong number of the calibration points");
+static_assert(calibSpans(0), "The calibration points should ascend by less than 256 Celsius");
 const uint16_t max_fan_speed    = 1999;                                     // Maximum Hot Air Gun Fan speed
 const uint16_t min_fan_speed	= 600;
 const uint16_t tune_fan_speed	= 1200;										// Hot Air Gun speed in tune mode
+const uint16_t gs_fan[3]		= {600, 1200, 1999};						// Fan speed points of the PID gain schedule
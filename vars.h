@@ -7,9 +7,18 @@ extern const uint16_t temp_minC;                // Maximum possible temperature
 extern const uint16_t temp_maxC;                // Maximum possible temperature
 extern const uint16_t temp_ambC;                // Average ambient temperature
 extern const uint16_t temp_max;                 // Maximum possible temperature in internal units
-extern const uint16_t temp_tip[3];              // Temperature reference points for calibration
+extern const uint16_t temp_cutoff;              // The over heating and open sensor cutoff in internal units
+const uint16_t        max_reading = 4092;       // The highest reading: 16 10-bit conversions decimated to 12 bits, see HOTGUN_HW
+extern const uint16_t temp_tip[3];              // Temperature points of the PID gain schedule
+const uint8_t         max_calib_points = 8;     // The maximum number of the calibration reference points, see cfg
+extern const uint8_t  calib_points;             // The number of the calibration reference points, 2 - max_calib_points
+extern const uint16_t calib_tip[max_calib_points];  // Temperature reference points for calibration, ascending
 extern const uint16_t max_fan_speed;            // Maximum Hot Air Gun Fan speed
 extern const uint16_t min_fan_speed;
 extern const uint16_t tune_fan_speed;
+extern const uint16_t gs_fan[3];                // Fan speed points of the PID gain schedule
+
+typedef int16_t PID_TABLE[3][3][3];             // PID coefficients by the temperature (temp_tip) and the fan speed (gs_fan)
+typedef uint8_t PWR_TABLE[3][3];                // The steady-state power by the temperature (temp_tip) and the fan speed (gs_fan)
 
 #endif